@@ -0,0 +1,218 @@
+/** Microbenchmarks of the hot paths of the jit itself.
+
+  Built as a shared library next to librjit and loaded into R by run.r, as
+  everything here needs a running R. Each benchmark reports the median time
+  per operation of a few batches in nanoseconds.
+ */
+
+#include "Compiler.h"
+#include "CodeCache.h"
+#include "ICCompiler.h"
+#include "ICSlots.h"
+#include "JITModule.h"
+#include "Protect.h"
+#include "Runtime.h"
+#include "StackMap.h"
+#include "StackScan.h"
+#include "TypeInfo.h"
+
+#include "api.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace rjit;
+
+namespace {
+
+struct Result {
+    std::string benchmark;
+    int param;
+    double ns;
+};
+
+std::vector<Result> results;
+
+volatile uintptr_t sink;
+
+/** Median of 5 batches of given number of iterations, per iteration.
+ */
+template <typename F>
+double nsPerOp(unsigned iterations, F f) {
+    typedef std::chrono::steady_clock Clock;
+    std::vector<double> batches;
+    for (int b = 0; b < 5; ++b) {
+        auto start = Clock::now();
+        for (unsigned i = 0; i < iterations; ++i)
+            f();
+        std::chrono::duration<double, std::nano> d = Clock::now() - start;
+        batches.push_back(d.count() / iterations);
+    }
+    std::sort(batches.begin(), batches.end());
+    return batches[2];
+}
+
+void record(std::string const& benchmark, int param, double ns) {
+    results.push_back({benchmark, param, ns});
+}
+
+/** x + 1 + 1 + ... with size additions.
+ */
+SEXP bodyOfSize(int size) {
+    Protect p;
+    SEXP body = p(install("x"));
+    for (int i = 0; i < size; ++i)
+        body = p(lang3(install("+"), body, ScalarReal(1)));
+    return body;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+/** Building the IR and finalizing the module are timed apart.
+ */
+void benchmarkCompile(unsigned iterations) {
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double, std::nano> Ns;
+    Protect p;
+    SEXP formals = p(CONS(R_MissingArg, R_NilValue));
+    SET_TAG(formals, install("x"));
+
+    for (int size : {1, 10, 100, 1000}) {
+        SEXP body = p(bodyOfSize(size));
+        std::vector<double> compile, finalize;
+        for (unsigned i = 0; i < iterations; ++i) {
+            auto start = Clock::now();
+            Compiler c("module");
+            sink = (uintptr_t)c.compile("rfunction", body, formals);
+            auto compiled = Clock::now();
+            c.finalize();
+            compile.push_back(Ns(compiled - start).count());
+            finalize.push_back(Ns(Clock::now() - compiled).count());
+        }
+        record("compile", size, median(compile));
+        record("JITCompileLayer::finalize", size, median(finalize));
+    }
+}
+
+void benchmarkCodeCache(unsigned iterations) {
+    std::string name = ICCompiler::stubName(1);
+    if (!CodeCache::contains(name))
+        return;
+    record("CodeCache::getAddress", 0, nsPerOp(iterations, [&name]() {
+               sink = CodeCache::getAddress(name);
+           }));
+
+    JITModule m("microbench", llvm::getGlobalContext());
+    record("CodeCache::get", 0, nsPerOp(iterations, [&name, &m]() {
+               sink = (uintptr_t)CodeCache::get(name, []() {
+                   assert(false);
+                   return (llvm::Function*)nullptr;
+               }, &m);
+           }));
+}
+
+void benchmarkMergeAll(unsigned iterations) {
+    Protect p;
+    for (int length : {1, 100, 10000}) {
+        SEXP v = p(allocVector(REALSXP, length));
+        for (int i = 0; i < length; ++i)
+            REAL(v)[i] = i;
+        record("TypeInfo::mergeAll", length, nsPerOp(iterations, [v]() {
+                   TypeInfo t;
+                   t.mergeAll(v);
+                   sink = static_cast<int>(t);
+               }));
+    }
+}
+
+void benchmarkPatchIC(unsigned iterations) {
+    ICSlots::Slot* slot = ICSlots::allocate();
+    // targets outside of the jitted code do not hold a region
+    void* targets[] = {(void*)&benchmarkMergeAll, (void*)&benchmarkPatchIC};
+    unsigned i = 0;
+    record("patchIC", 0, nsPerOp(iterations, [slot, &targets, &i]() {
+               patchIC(targets[++i & 1], (uint64_t)slot, nullptr);
+           }));
+    ICSlots::free(slot);
+}
+
+void noForward(SEXP) {}
+
+SEXP report() {
+    int n = results.size();
+    Protect p;
+    SEXP result = p(allocVector(VECSXP, 3));
+    SEXP benchmark = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 0, benchmark);
+    SEXP param = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, 1, param);
+    SEXP ns = allocVector(REALSXP, n);
+    SET_VECTOR_ELT(result, 2, ns);
+    for (int i = 0; i < n; ++i) {
+        SET_STRING_ELT(benchmark, i, mkChar(results[i].benchmark.c_str()));
+        INTEGER(param)[i] = results[i].param;
+        REAL(ns)[i] = results[i].ns;
+    }
+    results.clear();
+
+    SEXP names = p(allocVector(STRSXP, 3));
+    SET_STRING_ELT(names, 0, mkChar("benchmark"));
+    SET_STRING_ELT(names, 1, mkChar("param"));
+    SET_STRING_ELT(names, 2, mkChar("ns"));
+    setAttrib(result, R_NamesSymbol, names);
+    SEXP rowNames = p(allocVector(INTSXP, 2));
+    INTEGER(rowNames)[0] = NA_INTEGER;
+    INTEGER(rowNames)[1] = -n;
+    setAttrib(result, R_RowNamesSymbol, rowNames);
+    setAttrib(result, R_ClassSymbol, mkString("data.frame"));
+    return result;
+}
+}
+
+/** Runs the benchmarks which do not depend on the R stack.
+ */
+REXPORT SEXP rjitMicrobench(SEXP iterations) {
+    unsigned n = asInteger(iterations);
+    benchmarkCompile(std::max(1u, n / 1000));
+    benchmarkCodeCache(n);
+    benchmarkMergeAll(n);
+    benchmarkPatchIC(n);
+    return report();
+}
+
+/** Scans the current stack, called by run.r from a recursion of jitted
+  functions of given depth.
+ */
+REXPORT SEXP rjitMicrobenchStack(SEXP iterations, SEXP depth) {
+    unsigned n = asInteger(iterations);
+    int d = asInteger(depth);
+
+    record("StackScan::stackScanner", d, nsPerOp(n, []() {
+               StackScan::stackScanner(&noForward);
+           }));
+
+    std::vector<uintptr_t> pcs = StackScan::returnAddresses();
+    pcs.erase(std::remove_if(pcs.begin(), pcs.end(),
+                             [](uintptr_t pc) {
+                                 return !StackMap::findStatepoint(pc);
+                             }),
+              pcs.end());
+    if (!pcs.empty()) {
+        unsigned i = 0;
+        record("StackMap::findStatepoint", d, nsPerOp(n, [&pcs, &i]() {
+                   sink = (uintptr_t)StackMap::findStatepoint(
+                       pcs[i++ % pcs.size()]);
+               }));
+    }
+    record("StackMap::findStatepoint (miss)", d, nsPerOp(n, []() {
+               sink = (uintptr_t)StackMap::findStatepoint(1);
+           }));
+    return report();
+}
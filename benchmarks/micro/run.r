@@ -0,0 +1,22 @@
+# Runs the microbenchmarks of the jit.
+#
+# Usage: R --slave -f run.r --args <librjit> <librjit_microbench> [iterations]
+#
+# Normally run by the microbench target of the cmake build.
+
+args = commandArgs(trailingOnly = TRUE)
+iterations = if (length(args) >= 3) as.integer(args[[3]]) else 100000L
+
+dyn.load(args[[1]])
+source("rjit/R/rjit.R")
+dyn.load(args[[2]])
+
+results = .Call("rjitMicrobench", iterations)
+
+# the stack scan is measured at the bottom of a recursion of jitted functions
+rec <- jit.compile(function(n, hook) if (n == 0) hook() else rec(n - 1, hook))
+for (depth in c(1L, 10L, 100L))
+    results = rbind(results, rec(depth, function() .Call("rjitMicrobenchStack", iterations %/% 10L, depth)))
+
+results$ns = round(results$ns, 1)
+print(results, row.names = FALSE)
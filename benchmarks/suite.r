@@ -0,0 +1,220 @@
+# Benchmark suite runner
+#
+# Every benchmark is run in a number of fresh R processes. Each process times
+# the first call of execute(), which includes compilation, then runs a number
+# of untimed warmup calls and times the steady state calls. It also reports
+# its peak RSS and, when rjit is loaded, the memory of the jitted code.
+#
+# The results are summarized per benchmark as medians with 95% confidence
+# intervals and written as csv. Given a baseline csv of an earlier run, the
+# steady state medians are compared against it and regressions are flagged.
+#
+# Usage (from any directory):
+#
+#   Rscript suite.r [runs 5] [iterations 10] [warmup 2] [out results.csv]
+#                   [baseline baseline.csv] [threshold 0.05] {roots}
+#
+# Roots are directories (searched recursively for *.r files) or files,
+# relative to the benchmarks directory, shootout by default. The R used is the
+# one running this script, the environment (R_ENABLE_JIT, R_LIBS_USER, ...) is
+# passed on to the benchmark processes. The exit status is 1 if a regression
+# was found.
+
+scriptPath <- function() {
+    file = sub("^--file=", "", grep("^--file=", commandArgs(), value = TRUE))
+    normalizePath(file[[1]])
+}
+
+# peak resident set size of this process in kB
+peakRSS <- function() {
+    status = readLines("/proc/self/status")
+    line = grep("^VmHWM:", status, value = TRUE)
+    if (length(line) == 0)
+        return(NA)
+    as.numeric(strsplit(trimws(sub("VmHWM:", "", line)), " ")[[1]][[1]])
+}
+
+# runs one benchmark in this process and writes the measurements to out
+child <- function(file, iterations, warmup, out) {
+    hasJit = suppressWarnings(require("rjit", quietly = TRUE))
+    e = new.env()
+    source(file, local = e)
+    quiet <- function(f) {
+        sink("/dev/null")
+        on.exit(sink())
+        f()
+    }
+    timed <- function() system.time(quiet(e$execute))[[3]]
+
+    first = timed()
+    for (i in seq_len(warmup))
+        quiet(e$execute)
+    steady = sapply(seq_len(iterations), function(i) timed())
+
+    result = c(
+        paste("first", first),
+        paste("steady", steady),
+        paste("rss", peakRSS()))
+    if (hasJit && exists("jit.codeMemory")) {
+        memory = jit.codeMemory()
+        result = c(result,
+            paste("codeRegions", memory[["regions"]]),
+            paste("codeBytes", memory[["bytes"]]))
+    }
+    writeLines(result, out)
+}
+
+# runs file in a fresh process, returns its measurements or NULL on failure
+runChild <- function(file, iterations, warmup) {
+    out = tempfile()
+    on.exit(unlink(out))
+    rscript = file.path(R.home("bin"), "Rscript")
+    status = system2(rscript, c(shQuote(scriptPath()), "child", shQuote(file),
+        iterations, warmup, shQuote(out)), stdout = FALSE, stderr = FALSE)
+    if (status != 0 || !file.exists(out))
+        return(NULL)
+    values = list()
+    for (l in strsplit(readLines(out), " "))
+        values[[l[[1]]]] = c(values[[l[[1]]]], as.numeric(l[[2]]))
+    values
+}
+
+# median and its distribution free 95% confidence interval
+medianCI <- function(x) {
+    x = sort(x[!is.na(x)])
+    n = length(x)
+    if (n == 0)
+        return(c(NA, NA, NA))
+    lo = max(1, qbinom(0.025, n, 0.5))
+    hi = min(n, n - lo + 1)
+    c(median(x), x[[lo]], x[[hi]])
+}
+
+benchmarkFiles <- function(roots) {
+    files = c()
+    for (root in roots) {
+        if (dir.exists(root))
+            files = c(files, file.path(root, list.files(root, pattern = "\\.r$", recursive = TRUE)))
+        else
+            files = c(files, root)
+    }
+    files
+}
+
+runSuite <- function(roots, runs, iterations, warmup) {
+    rows = list()
+    for (file in benchmarkFiles(roots)) {
+        cat(file, "")
+        first = c()
+        steady = c()
+        rss = c()
+        codeBytes = c()
+        codeRegions = c()
+        failed = 0
+        for (r in seq_len(runs)) {
+            m = runChild(file, iterations, warmup)
+            if (is.null(m)) {
+                failed = failed + 1
+                cat("x")
+                next
+            }
+            cat(".")
+            first = c(first, m$first)
+            steady = c(steady, m$steady)
+            rss = c(rss, m$rss)
+            codeBytes = c(codeBytes, if (is.null(m$codeBytes)) NA else m$codeBytes)
+            codeRegions = c(codeRegions, if (is.null(m$codeRegions)) NA else m$codeRegions)
+        }
+        cat("\n")
+        f = medianCI(first)
+        s = medianCI(steady)
+        rows[[length(rows) + 1]] = data.frame(
+            benchmark = file,
+            runs = runs - failed,
+            failed = failed,
+            first = f[[1]], firstLo = f[[2]], firstHi = f[[3]],
+            steady = s[[1]], steadyLo = s[[2]], steadyHi = s[[3]],
+            rssKB = if (length(rss)) max(rss) else NA,
+            codeBytes = if (length(codeBytes)) median(codeBytes) else NA,
+            codeRegions = if (length(codeRegions)) median(codeRegions) else NA,
+            stringsAsFactors = FALSE)
+    }
+    do.call(rbind, rows)
+}
+
+# A benchmark regressed when its steady state median is slower by more than
+# threshold and the confidence intervals of both runs do not overlap.
+compareToBaseline <- function(results, baseline, threshold) {
+    m = merge(results, baseline, by = "benchmark", suffixes = c("", ".base"))
+    data.frame(
+        benchmark = m$benchmark,
+        steady = m$steady,
+        baseline = m$steady.base,
+        ratio = m$steady / m$steady.base,
+        firstRatio = m$first / m$first.base,
+        rssRatio = m$rssKB / m$rssKB.base,
+        regression = m$steady / m$steady.base > 1 + threshold & m$steadyLo > m$steadyHi.base,
+        improvement = m$steady / m$steady.base < 1 - threshold & m$steadyHi < m$steadyLo.base,
+        stringsAsFactors = FALSE)
+}
+
+main <- function(args) {
+    runs = 5
+    iterations = 10
+    warmup = 2
+    out = "results.csv"
+    baseline = NULL
+    threshold = 0.05
+    roots = c()
+    i = 1
+    while (i <= length(args)) {
+        arg = args[[i]]
+        if (arg == "runs") {
+            i = i + 1
+            runs = as.integer(args[[i]])
+        } else if (arg == "iterations") {
+            i = i + 1
+            iterations = as.integer(args[[i]])
+        } else if (arg == "warmup") {
+            i = i + 1
+            warmup = as.integer(args[[i]])
+        } else if (arg == "out") {
+            i = i + 1
+            out = normalizePath(args[[i]], mustWork = FALSE)
+        } else if (arg == "baseline") {
+            i = i + 1
+            baseline = normalizePath(args[[i]])
+        } else if (arg == "threshold") {
+            i = i + 1
+            threshold = as.numeric(args[[i]])
+        } else {
+            roots = c(roots, arg)
+        }
+        i = i + 1
+    }
+    if (length(roots) == 0)
+        roots = "shootout"
+
+    # the benchmarks read their inputs relative to the benchmarks directory
+    setwd(dirname(scriptPath()))
+    results = runSuite(roots, runs, iterations, warmup)
+    write.csv(results, out, row.names = FALSE)
+    print(results[, c("benchmark", "first", "steady", "steadyLo", "steadyHi", "rssKB", "codeBytes")])
+
+    if (!is.null(baseline)) {
+        comparison = compareToBaseline(results, read.csv(baseline, stringsAsFactors = FALSE), threshold)
+        write.csv(comparison, sub("\\.csv$", "-comparison.csv", out), row.names = FALSE)
+        print(comparison)
+        if (any(comparison$regression, na.rm = TRUE)) {
+            cat("Regressions:", comparison$benchmark[comparison$regression %in% TRUE], sep = "\n  ")
+            quit(status = 1)
+        }
+    }
+}
+
+args = commandArgs(trailingOnly = TRUE)
+if (length(args) > 0 && args[[1]] == "child") {
+    child(args[[2]], as.integer(args[[3]]), as.integer(args[[4]]), args[[5]])
+} else {
+    main(args)
+}
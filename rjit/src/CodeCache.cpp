@@ -4,51 +4,57 @@ using namespace llvm;
 
 namespace rjit {
 
-std::unordered_map<std::string, std::pair<llvm::FunctionType*, uint64_t>>
-    CodeCache::cache;
+StringMap<CodeCache::Entry> CodeCache::cache;
 
-void CodeCache::setAddress(std::string name, uint64_t addr) {
-    assert(cache.count(name));
-    assert(std::get<1>(cache.at(name)) == 0);
-    std::get<1>(cache.at(name)) = addr;
+void CodeCache::setAddress(StringRef name, uint64_t addr) {
+    auto i = cache.find(name);
+    assert(i != cache.end());
+    assert(i->second.address == 0);
+    i->second.address = addr;
 }
-uint64_t CodeCache::getAddress(std::string name) {
-    if (!cache.count(name))
+
+uint64_t CodeCache::getAddress(StringRef name) {
+    auto i = cache.find(name);
+    if (i == cache.end())
         return 0;
-    auto res = std::get<1>(cache.at(name));
-    assert(res);
-    return res;
+    assert(i->second.address);
+    return i->second.address;
 }
-bool CodeCache::missingAddress(std::string name) {
-    return cache.count(name) && !std::get<1>(cache.at(name));
+
+bool CodeCache::missingAddress(StringRef name) {
+    auto i = cache.find(name);
+    return i != cache.end() && !i->second.address;
 }
 
-uint64_t CodeCache::getAddress(std::string name,
+uint64_t CodeCache::getAddress(StringRef name,
                                std::function<uint64_t()> function) {
-    if (cache.count(name)) {
-        return getAddress(name);
+    auto i = cache.find(name);
+    if (i != cache.end()) {
+        assert(i->second.address);
+        return i->second.address;
     }
 
     auto a = function();
-    cache[name] = std::pair<FunctionType*, uint64_t>(nullptr, a);
+    cache[name] = Entry{nullptr, a};
     return a;
 }
 
-llvm::Function* CodeCache::get(std::string name,
+llvm::Function* CodeCache::get(StringRef name,
                                std::function<llvm::Function*()> function,
                                llvm::Module* m) {
     auto here = m->getFunction(name);
     if (here)
         return here;
 
-    if (cache.count(name)) {
-        auto ty = std::get<0>(cache.at(name));
-        assert(ty);
-        return Function::Create(ty, GlobalValue::ExternalLinkage, name, m);
+    auto i = cache.find(name);
+    if (i != cache.end()) {
+        assert(i->second.type);
+        return Function::Create(i->second.type, GlobalValue::ExternalLinkage,
+                                name, m);
     }
 
     auto f = function();
-    cache[name] = std::pair<FunctionType*, uint64_t>(f->getFunctionType(), 0);
+    cache[name] = Entry{f->getFunctionType(), 0};
     return f;
 }
 }
@@ -1,28 +1,38 @@
 #ifndef CODE_CACHE_H
 #define CODE_CACHE_H
 
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
-#include <unordered_map>
 #include <functional>
 
 namespace rjit {
 
+/** Code shared between modules (IC stubs, special ICs), by symbol name.
+
+  Names are only copied into the cache when an entry is created, lookups
+  take a StringRef and do not allocate.
+ */
 class CodeCache {
   public:
-    static llvm::Function* get(std::string name,
+    static llvm::Function* get(llvm::StringRef name,
                                std::function<llvm::Function*()> function,
                                llvm::Module* m);
-    static uint64_t getAddress(std::string name,
+    static uint64_t getAddress(llvm::StringRef name,
                                std::function<uint64_t()> function);
-    static void setAddress(std::string name, uint64_t addr);
-    static uint64_t getAddress(std::string name);
-    static bool missingAddress(std::string name);
-    static bool contains(std::string name) { return cache.count(name); }
+    static void setAddress(llvm::StringRef name, uint64_t addr);
+    static uint64_t getAddress(llvm::StringRef name);
+    static bool missingAddress(llvm::StringRef name);
+    static bool contains(llvm::StringRef name) { return cache.count(name); }
 
   private:
-    static std::unordered_map<std::string,
-                              std::pair<llvm::FunctionType*, uint64_t>> cache;
+    struct Entry {
+        llvm::FunctionType* type;
+        uint64_t address;
+    };
+
+    static llvm::StringMap<Entry> cache;
 };
 }
 
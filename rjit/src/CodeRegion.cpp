@@ -0,0 +1,158 @@
+#include "CodeRegion.h"
+#include "StackMap.h"
+#include "StackScan.h"
+#include "CodeSymbols.h"
+#include "IntrinsicCounters.h"
+#include "Profiler.h"
+#include "JITMemoryManager.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+
+using namespace llvm;
+
+namespace rjit {
+
+std::map<uintptr_t, CodeRegion*> CodeRegion::regions;
+std::unordered_map<ICSlots::Slot*, CodeRegion*> CodeRegion::targets;
+std::vector<CodeRegion*> CodeRegion::pending;
+size_t CodeRegion::count = 0;
+size_t CodeRegion::bytes = 0;
+
+CodeRegion::CodeRegion(std::vector<sys::MemoryBlock> const& code,
+                       std::vector<sys::MemoryBlock> const& data)
+    : code(code), data(data) {
+    for (auto& b : code) {
+        regions[(uintptr_t)b.base()] = this;
+        bytes += b.size();
+    }
+    for (auto& b : data)
+        bytes += b.size();
+    ++count;
+}
+
+CodeRegion::~CodeRegion() {
+    for (auto& b : code) {
+        uintptr_t begin = (uintptr_t)b.base();
+        StackMap::unregisterStatepoints(begin, begin + b.size());
+        CodeSymbols::unregister(begin, begin + b.size());
+        Profiler::unregister(begin, begin + b.size());
+        IntrinsicCounters::unregister(begin, begin + b.size());
+        regions.erase(begin);
+        bytes -= b.size();
+        SlabAllocator::free(b);
+    }
+    for (auto& b : data) {
+        bytes -= b.size();
+        SlabAllocator::free(b);
+    }
+    --count;
+}
+
+void CodeRegion::freeData(void* section) {
+    for (auto i = data.begin(); i != data.end(); ++i) {
+        if (i->base() == section) {
+            bytes -= i->size();
+            SlabAllocator::free(*i);
+            data.erase(i);
+            return;
+        }
+    }
+    assert(false && "Section not in the region");
+}
+
+CodeRegion* CodeRegion::find(uintptr_t pc) {
+    auto i = regions.upper_bound(pc);
+    if (i == regions.begin())
+        return nullptr;
+    --i;
+    for (auto& b : i->second->code)
+        if ((uintptr_t)b.base() == i->first)
+            return pc < i->first + b.size() ? i->second : nullptr;
+    return nullptr;
+}
+
+SEXP CodeRegion::token() {
+    assert(!natives);
+    natives = true;
+    SEXP token = R_MakeExternalPtr(this, R_NilValue, R_NilValue);
+    PROTECT(token);
+    R_RegisterCFinalizer(token, &finalizeToken);
+    UNPROTECT(1);
+    return token;
+}
+
+void CodeRegion::finalizeToken(SEXP token) {
+    auto region = static_cast<CodeRegion*>(R_ExternalPtrAddr(token));
+    R_ClearExternalPtr(token);
+    region->natives = false;
+    region->release();
+}
+
+void CodeRegion::patched(ICSlots::Slot* slot, void* ic) {
+    CodeRegion* target = find((uintptr_t)ic);
+    if (target)
+        ++target->sites;
+
+    CodeRegion*& site = targets[slot];
+    CodeRegion* old = site;
+    site = target;
+
+    if (old) {
+        --old->sites;
+        old->release();
+    }
+}
+
+void CodeRegion::release() {
+    if (dead() && std::find(pending.begin(), pending.end(), this) ==
+                      pending.end())
+        pending.push_back(this);
+    reclaim();
+}
+
+void CodeRegion::reclaim() {
+    if (pending.empty())
+        return;
+
+    std::vector<uintptr_t> active;
+    if (not StackScan::returnAddresses(active)) {
+        // Frames may be missing, so every word on the stack which points
+        // into a region is treated as a return address.
+        active.clear();
+        StackScan::stackWords([&active](uintptr_t w) {
+            if (find(w))
+                active.push_back(w);
+        });
+    }
+
+    // Freeing a region frees its IC slots, which can kill the regions of
+    // their ICs. Those are handled by the following iterations.
+    for (size_t i = 0; i < pending.size();) {
+        CodeRegion* r = pending[i];
+        bool onStack = std::any_of(active.begin(), active.end(),
+                                   [r](uintptr_t pc) { return find(pc) == r; });
+        if (onStack) {
+            ++i;
+            continue;
+        }
+        pending.erase(pending.begin() + i);
+        if (!r->dead())
+            continue;
+
+        for (auto slot : r->slots) {
+            ICSlots::free(slot);
+            auto t = targets.find(slot);
+            if (t == targets.end())
+                continue;
+            CodeRegion* ic = t->second;
+            targets.erase(t);
+            if (ic && --ic->sites == 0 && ic->dead())
+                pending.push_back(ic);
+        }
+        delete r;
+        i = 0;
+    }
+}
+}
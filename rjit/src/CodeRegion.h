@@ -0,0 +1,110 @@
+#ifndef CODE_REGION_H
+#define CODE_REGION_H
+
+#include <llvm/Support/Memory.h>
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "RDefs.h"
+#include "ICSlots.h"
+
+namespace rjit {
+
+/** Memory of one finalized module.
+
+  The memory manager of a module is deleted together with its execution
+  engine right after finalization, so it hands its memory blocks over to a
+  region. The region returns them to the SlabAllocator, and unregisters the
+  module's stackmap records, once its code cannot be entered any more:
+
+  - no NATIVESXP of the module is alive. All of them hold the same external
+    pointer in the last slot of their constant pool, its finalizer drops this
+    reference,
+  - no IC slot points into the region (ICs),
+  - no return address on the stack points into the region.
+
+  Regions defining code which is shared through the CodeCache (IC stubs and
+  special ICs) are pinned and never freed.
+ */
+class CodeRegion {
+  public:
+    CodeRegion(std::vector<llvm::sys::MemoryBlock> const& code,
+               std::vector<llvm::sys::MemoryBlock> const& data);
+
+    /** Returns the region whose code contains given address, or nullptr.
+     */
+    static CodeRegion* find(uintptr_t pc);
+
+    /** Returns a new external pointer which keeps the region alive while it
+      is reachable.
+
+      Must only be called once per region.
+     */
+    SEXP token();
+
+    void pin() { pinned = true; }
+
+    /** Frees a data section of the region early, once nothing refers to it
+      any more (e.g. the stackmaps after they were recorded).
+     */
+    void freeData(void* section);
+
+    /** Registers the IC slot of a call site in the region's code. The slot is
+      freed together with the region.
+     */
+    void addICSlot(ICSlots::Slot* slot) { slots.push_back(slot); }
+
+    /** Records that the IC slot now points to ic.
+
+      The region of the previous target of the slot is released.
+     */
+    static void patched(ICSlots::Slot* slot, void* ic);
+
+    /** Number of regions and the bytes of code and data they hold.
+     */
+    static size_t liveRegions() { return count; }
+    static size_t liveBytes() { return bytes; }
+
+  private:
+    ~CodeRegion();
+
+    bool dead() const { return !pinned && !natives && sites == 0; }
+
+    /** Called whenever a reference to the region is dropped.
+     */
+    void release();
+
+    /** Frees all dead regions which are not active on the stack.
+     */
+    static void reclaim();
+
+    static void finalizeToken(SEXP token);
+
+    std::vector<llvm::sys::MemoryBlock> code;
+    std::vector<llvm::sys::MemoryBlock> data;
+    std::vector<ICSlots::Slot*> slots;
+
+    bool pinned = false;
+    bool natives = false;
+    unsigned sites = 0;
+
+    /** Regions by the start of each of their code blocks.
+     */
+    static std::map<uintptr_t, CodeRegion*> regions;
+
+    /** Current target region of each IC slot.
+     */
+    static std::unordered_map<ICSlots::Slot*, CodeRegion*> targets;
+
+    /** Dead regions waiting for their frames to return.
+     */
+    static std::vector<CodeRegion*> pending;
+
+    static size_t count;
+    static size_t bytes;
+};
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "CodeSymbols.h"
+#include "JITModule.h"
+#include "Sampler.h"
+
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+
+#include "RIntlns.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace llvm;
+
+namespace rjit {
+
+CodeSymbols CodeSymbols::singleton;
+
+std::string CodeSymbols::location(SEXP ast) {
+    SEXP srcref = getAttrib(ast, R_SrcrefSymbol);
+    // a { call has a srcref for itself and each statement
+    if (TYPEOF(srcref) == VECSXP && XLENGTH(srcref) > 0)
+        srcref = VECTOR_ELT(srcref, 0);
+    if (TYPEOF(srcref) != INTSXP || XLENGTH(srcref) < 1)
+        return "";
+
+    std::string file = "<text>";
+    SEXP srcfile = getAttrib(srcref, install("srcfile"));
+    if (TYPEOF(srcfile) == ENVSXP) {
+        SEXP name = findVarInFrame(srcfile, install("filename"));
+        if (TYPEOF(name) == STRSXP && XLENGTH(name) > 0 &&
+            CHAR(STRING_ELT(name, 0))[0] != '\0')
+            file = CHAR(STRING_ELT(name, 0));
+    }
+    return file + ":" + std::to_string(INTEGER(srcref)[0]);
+}
+
+void CodeSymbols::NotifyObjectEmitted(
+    const object::ObjectFile& obj,
+    const RuntimeDyld::LoadedObjectInfo& info) {
+    // the debug object has the sections at their load addresses
+    object::OwningBinary<object::ObjectFile> debug =
+        info.getObjectForDebug(obj);
+    if (!debug.getBinary())
+        return;
+
+    for (auto& s : object::computeSymbolSizes(*debug.getBinary())) {
+        object::SymbolRef sym = s.first;
+        if (sym.getType() != object::SymbolRef::ST_Function)
+            continue;
+        ErrorOr<StringRef> name = sym.getName();
+        ErrorOr<uint64_t> address = sym.getAddress();
+        if (!name || !address || s.second == 0)
+            continue;
+        emitted.push_back({name->str(), (uintptr_t)*address, s.second});
+    }
+}
+
+void CodeSymbols::finalize(JITModule* m) {
+    for (auto& e : emitted) {
+        Symbol& s = live[e.start];
+        s = Symbol();
+        s.start = e.start;
+        s.size = e.size;
+        s.name = e.name;
+
+        llvm::Function* f = m->getFunction(e.name);
+        SEXP native = f ? m->nativeSXP(f) : nullptr;
+        if (native)
+            s.location = location(VECTOR_ELT(CDR(native), 0));
+
+        writePerfMap(s);
+    }
+    emitted.clear();
+}
+
+void CodeSymbols::writePerfMap(Symbol const& s) {
+    if (!perfMapOpened) {
+        perfMapOpened = true;
+        const char* env = getenv("RJIT_PERF_MAP");
+        if (env && *env && *env != '0') {
+            std::string path =
+                "/tmp/perf-" + std::to_string(getpid()) + ".map";
+            perfMap = fopen(path.c_str(), "a");
+        }
+    }
+    if (!perfMap)
+        return;
+
+    fprintf(perfMap, "%lx %lx rjit:%s%s%s\n", (unsigned long)s.start,
+            (unsigned long)s.size, s.name.c_str(),
+            s.location.empty() ? "" : " ", s.location.c_str());
+    fflush(perfMap);
+}
+
+CodeSymbols::Symbol* CodeSymbols::find(uintptr_t pc) {
+    auto& live = singleton.live;
+    auto i = live.upper_bound(pc);
+    if (i == live.begin())
+        return nullptr;
+    --i;
+    return pc < i->first + i->second.size ? &i->second : nullptr;
+}
+
+void CodeSymbols::unregister(uintptr_t begin, uintptr_t end) {
+    // samples taken so far may point into the code
+    Sampler::aggregate();
+
+    auto& live = singleton.live;
+    auto i = live.lower_bound(begin);
+    while (i != live.end() && i->first < end) {
+        if (i->second.total)
+            singleton.retired.push_back(i->second);
+        i = live.erase(i);
+    }
+}
+}
@@ -0,0 +1,96 @@
+#ifndef CODE_SYMBOLS_H
+#define CODE_SYMBOLS_H
+
+#include "llvm/ExecutionEngine/JITEventListener.h"
+
+#include "RDefs.h"
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+class JITModule;
+
+namespace rjit {
+
+/** Symbols of the jitted code.
+
+  Registered as a JITEventListener with the execution engine of every module,
+  it records name, address and size of all functions (closures, promises and
+  ICs) the module defines. The symbols are used to attribute samples of the
+  Sampler to R functions.
+
+  When the RJIT_PERF_MAP environment variable is set, each symbol is also
+  appended to /tmp/perf-<pid>.map, so that perf can symbolize jitted frames.
+ */
+class CodeSymbols : public llvm::JITEventListener {
+  public:
+    struct Symbol {
+        uintptr_t start;
+        size_t size;
+        std::string name;
+        /** file:line of the AST of the function, if it has a srcref.
+         */
+        std::string location;
+        /** Samples in which the function was the innermost jitted frame, and
+          in which it was anywhere on the stack.
+         */
+        unsigned self = 0;
+        unsigned total = 0;
+    };
+
+    static CodeSymbols singleton;
+
+    void NotifyObjectEmitted(
+        const llvm::object::ObjectFile& obj,
+        const llvm::RuntimeDyld::LoadedObjectInfo& info) override;
+
+    /** Registers the symbols emitted for module m.
+     */
+    void finalize(JITModule* m);
+
+    /** Returns the symbol whose code contains pc, or nullptr.
+     */
+    static Symbol* find(uintptr_t pc);
+
+    /** Removes the symbols of freed code. Symbols with samples are kept for
+      the report.
+     */
+    static void unregister(uintptr_t begin, uintptr_t end);
+
+    /** Returns file:line of the srcref of given ast, or an empty string.
+     */
+    static std::string location(SEXP ast);
+
+    /** Calls f for every live and retired symbol.
+     */
+    template <typename F>
+    static void forEach(F f) {
+        for (auto& s : singleton.live)
+            f(s.second);
+        for (auto& s : singleton.retired)
+            f(s);
+    }
+
+  private:
+    void writePerfMap(Symbol const& s);
+
+    /** Symbols of the last emitted object, name, address and size.
+     */
+    struct Emitted {
+        std::string name;
+        uintptr_t start;
+        size_t size;
+    };
+    std::vector<Emitted> emitted;
+
+    std::map<uintptr_t, Symbol> live;
+    std::vector<Symbol> retired;
+
+    FILE* perfMap = nullptr;
+    bool perfMapOpened = false;
+};
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "CompilePolicy.h"
+#include "Protect.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace rjit {
+
+namespace {
+
+/** Stops counting at this size, the body is large in any case.
+ */
+constexpr unsigned maxNodes = 100000;
+
+void countNodes(SEXP ast, unsigned& nodes, bool& loops) {
+    while (nodes < maxNodes) {
+        ++nodes;
+        switch (TYPEOF(ast)) {
+        case LANGSXP: {
+            SEXP f = CAR(ast);
+            if (f == install("for") || f == install("while") ||
+                f == install("repeat"))
+                loops = true;
+            for (SEXP arg = CDR(ast); arg != R_NilValue; arg = CDR(arg))
+                countNodes(CAR(arg), nodes, loops);
+            // the function is usually a symbol
+            ast = f;
+            break;
+        }
+        case BCODESXP:
+            ast = VECTOR_ELT(CDR(ast), 0);
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+double budgetFromEnv() {
+    const char* env = getenv("RJIT_COMPILE_BUDGET");
+    return env ? atof(env) : 0.25;
+}
+}
+
+double CompilePolicy::budget = budgetFromEnv();
+unsigned CompilePolicy::smallFunction = 200;
+double CompilePolicy::available = CompilePolicy::budget;
+CompilePolicy::Clock::time_point CompilePolicy::lastRefill =
+    CompilePolicy::Clock::now();
+// roughly what a baseline compilation takes, before the first measurement
+double CompilePolicy::secondsPerNode = 20e-6;
+std::unordered_map<SEXP, CompilePolicy::Candidate> CompilePolicy::deferred;
+unsigned CompilePolicy::compilations = 0;
+unsigned CompilePolicy::deferrals = 0;
+double CompilePolicy::compileTime = 0;
+
+CompilePolicy::Candidate CompilePolicy::analyze(SEXP body) {
+    Candidate c;
+    c.nodes = 0;
+    c.loops = false;
+    countNodes(body, c.nodes, c.loops);
+    return c;
+}
+
+void CompilePolicy::refill() {
+    auto now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastRefill).count();
+    lastRefill = now;
+    available = std::min(budget, available + elapsed * budget);
+}
+
+bool CompilePolicy::compileNow(SEXP body) {
+    if (budget <= 0)
+        return true;
+
+    auto i = deferred.find(body);
+    Candidate c = i == deferred.end() ? analyze(body) : i->second;
+    ++c.requests;
+
+    refill();
+    double cost = c.nodes * secondsPerNode;
+    // small bodies and loops are likely to pay back their compilation
+    bool worthIt = c.loops || c.nodes <= smallFunction || c.requests > 1;
+    bool affordable = cost <= available || available >= budget;
+
+    if (worthIt && affordable)
+        return true;
+
+    ++deferrals;
+    deferred[body] = c;
+    return false;
+}
+
+void CompilePolicy::compiled(SEXP body, double seconds) {
+    ++compilations;
+    compileTime += seconds;
+    available -= seconds;
+
+    auto i = deferred.find(body);
+    unsigned nodes;
+    if (i == deferred.end()) {
+        nodes = analyze(body).nodes;
+    } else {
+        nodes = i->second.nodes;
+        deferred.erase(i);
+    }
+
+    // moving average, so that the estimate follows the current workload
+    secondsPerNode = 0.8 * secondsPerNode + 0.2 * seconds / std::max(1u, nodes);
+}
+
+void CompilePolicy::configure(double budget, unsigned smallFunction) {
+    CompilePolicy::budget = budget;
+    CompilePolicy::smallFunction = smallFunction;
+    available = budget;
+    lastRefill = Clock::now();
+}
+
+SEXP CompilePolicy::stats() {
+    // compile time of the bodies which were not compiled (yet)
+    double saved = 0;
+    for (auto& d : deferred)
+        saved += d.second.nodes * secondsPerNode;
+
+    const char* names[] = {"compilations", "compileTime", "deferrals",
+                           "deferred", "savedTime", "secondsPerNode",
+                           "budget"};
+    double values[] = {(double)compilations, compileTime, (double)deferrals,
+                       (double)deferred.size(), saved, secondsPerNode,
+                       budget};
+    int n = sizeof(values) / sizeof(values[0]);
+
+    Protect p;
+    SEXP result = p(allocVector(REALSXP, n));
+    SEXP resultNames = p(allocVector(STRSXP, n));
+    for (int i = 0; i < n; ++i) {
+        REAL(result)[i] = values[i];
+        SET_STRING_ELT(resultNames, i, mkChar(names[i]));
+    }
+    setAttrib(result, R_NamesSymbol, resultNames);
+    return result;
+}
+
+void CompilePolicy::gcCallback(void (*forward_node)(SEXP)) {
+    for (auto& d : deferred)
+        forward_node(d.first);
+}
+}
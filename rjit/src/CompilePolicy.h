@@ -0,0 +1,93 @@
+#ifndef COMPILE_POLICY_H
+#define COMPILE_POLICY_H
+
+#include <chrono>
+#include <unordered_map>
+
+#include "RDefs.h"
+
+namespace rjit {
+
+/** Decides when compileIC compiles the closures it is called with.
+
+  The compile time of a body is estimated from the number of nodes of its
+  AST, calibrated by the times of the previous compilations. Bodies which are
+  likely to pay back their compilation, small ones and ones with loops, are
+  compiled right away. Large bodies without loops are deferred until they are
+  requested again, so that one-shot code such as package initialization is
+  never compiled. The IC of a deferred body counts its calls and requests it
+  again after deferredCalls calls, as do other call sites and IC misses.
+
+  All compilation is limited by a budget: compile time may take at most a
+  fraction of the elapsed time (RJIT_COMPILE_BUDGET, 0.25 by default, 0
+  disables the policy). The budget accumulates for at most one second and is
+  fully available at startup, a body whose estimate exceeds it is compiled
+  once the full budget is available. Bodies over the budget are deferred as
+  well.
+
+  The policy only applies to closures compiled in place of the bytecode
+  compiler (R_ENABLE_JIT, jit.enable(automatic = TRUE)), explicit requests
+  (RJIT_COMPILE, jit.enable()) compile every closure.
+
+  Deferred bodies are kept alive by the gc callback, so that their address
+  cannot be reused by another body while they are known.
+ */
+class CompilePolicy {
+  public:
+    /** Returns whether the body should be compiled now. If so, compiled must
+      be called with the time the compilation took.
+     */
+    static bool compileNow(SEXP body);
+
+    static void compiled(SEXP body, double seconds);
+
+    /** Calls of a deferred body after which its IC requests it again.
+     */
+    static constexpr unsigned deferredCalls = 1000;
+
+    static void configure(double budget, unsigned smallFunction);
+
+    /** Returns the statistics as a named numeric vector.
+     */
+    static SEXP stats();
+
+    static void gcCallback(void (*forward_node)(SEXP));
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Candidate {
+        unsigned nodes;
+        bool loops;
+        unsigned requests = 0;
+    };
+
+    static Candidate analyze(SEXP body);
+
+    /** Adds the budget accumulated since the last request.
+     */
+    static void refill();
+
+    static double budget;
+    static unsigned smallFunction;
+
+    /** Compile time which may be spent now, in seconds.
+     */
+    static double available;
+    static Clock::time_point lastRefill;
+
+    /** Calibrated compile time per AST node, in seconds.
+     */
+    static double secondsPerNode;
+
+    /** Bodies which were requested, but not compiled yet.
+     */
+    static std::unordered_map<SEXP, Candidate> deferred;
+
+    static unsigned compilations;
+    static unsigned deferrals;
+    static double compileTime;
+};
+}
+
+#endif
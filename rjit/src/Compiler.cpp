@@ -24,9 +24,11 @@
 #include "ir/Ir.h"
 
 #include "Instrumentation.h"
+#include "Profiler.h"
 #include "api.h"
 
 #include "Flags.h"
+#include "Protect.h"
 
 #include "RIntlns.h"
 
@@ -36,6 +38,7 @@ namespace rjit {
 
 SEXP Compiler::compilePromise(std::string const& name, SEXP ast) {
     b.openPromise(name, ast);
+    Profiler::Timer timer(b.f(), "ir");
     finalizeCompile(ast);
     return b.closePromise();
 }
@@ -59,6 +62,7 @@ SEXP Compiler::compileFunction(std::string const& name, SEXP ast, SEXP formals,
         }
         b.openFunction(name, ast, formals);
     }
+    Profiler::Timer timer(b.f(), "ir");
 
     if (!optimize && Flag::singleton().recompileHot) {
         // Check the invocation count and recompile the function if it is hot.
@@ -78,9 +82,15 @@ SEXP Compiler::compileFunction(std::string const& name, SEXP ast, SEXP formals,
         ir::Return::create(b, res);
 
         b.setBlock(next);
+        Profiler::countsInvocations(b.f());
+    } else if (Profiler::enabled()) {
+        ir::InvocationCount::create(b);
+        Profiler::countsInvocations(b.f());
     }
 
     finalizeCompile(ast);
+    if (auto tf = TypeFeedback::get(b.f()))
+        tf->checkSites();
 
     return b.closeFunction();
 }
@@ -95,10 +105,10 @@ void Compiler::finalizeCompile(SEXP ast) {
         compileReturn(last, /*tail=*/true);
 }
 
-void Compiler::finalize() {
+void Compiler::finalize(bool hot) {
     assert(!finalized);
 
-    auto engine = JITCompileLayer::singleton.finalize(b);
+    auto engine = JITCompileLayer::singleton.finalize(b, hot);
 
     if (!RJIT_DEBUG) {
         // Keep the llvm ir around
@@ -149,23 +159,28 @@ Value* Compiler::compileSymbol(SEXP value) {
     auto name = CHAR(PRINTNAME(value));
     assert(strlen(name));
     Value* res = ir::GenericGetVar::create(b, b.rho(), value)->result();
-    if (Flag::singleton().recordTypes && b.isFunction()) {
-        auto tf = TypeFeedback::get(b.f());
-        if (!tf) {
-            ir::RecordType::create(b, value, res);
-        } else {
-            TypeInfo inf = tf->get(value);
-            if (!Flag::singleton().unsafeOpt && !inf.isAny() &&
-                !inf.isBottom()) {
-                ir::CheckType::create(b, res,
-                                      TypeFeedback::get(b.f())->get(value));
-            }
-        }
-    }
+    compileTypeFeedback(value, res);
     res->setName(name);
     return res;
 }
 
+void Compiler::compileTypeFeedback(SEXP key, Value* value) {
+    if (!Flag::singleton().recordTypes || !b.isFunction())
+        return;
+    auto tf = TypeFeedback::get(b.f());
+    if (!tf) {
+        ir::RecordType::create(b, key, value);
+        return;
+    }
+    int slot = tf->nextSlot(key);
+    if (slot < 0)
+        return;
+    tf->bind(value, slot);
+    TypeInfo inf = tf->get(slot);
+    if (!Flag::singleton().unsafeOpt && !inf.isAny() && !inf.isBottom())
+        tf->guard(ir::CheckType::create(b, value, inf)->first(), slot);
+}
+
 /** Inline caching for a function (call) with operator (op)
  *  that have arguments (callArgs).
  */
@@ -217,7 +232,12 @@ Value* Compiler::compileCall(SEXP call) {
     std::vector<Value*> args;
     compileArguments(CDR(call), args);
 
-    return compileICCallStub(ir::Constant::create(b, call)->result(), f, args);
+    // The arguments are promises, their types are recorded where the callee
+    // reads them. The result is recorded per call site.
+    Value* res =
+        compileICCallStub(ir::Constant::create(b, call)->result(), f, args);
+    compileTypeFeedback(call, res);
+    return res;
 }
 
 void Compiler::compileArguments(SEXP argAsts, std::vector<Value*>& res) {
@@ -830,17 +850,45 @@ Value* Compiler::compileSuperAssignment(SEXP e) {
     return result;
 }
 
-/** Similar to R bytecode compiler, only the body of the created function is
-  compiled, the default arguments are left in their ast forms for now.
-
-  TODO this should change.
+/** Both the body of the created function and its default arguments are
+  compiled. See compileFormals for the latter.
  */
 Value* Compiler::compileFunctionDefinition(SEXP fdef) {
-    SEXP forms = CAR(fdef);
+    Protect p;
+    SEXP forms = p(compileFormals(CAR(fdef)));
     SEXP body = compileFunction("function", CAR(CDR(fdef)), forms);
     return ir::CreateClosure::create(b, b.rho(), forms, body)->result();
 }
 
+/** Default arguments which are calls are compiled into native promise code.
+  When a default is used, R wraps it in a promise in the callee's environment,
+  exactly as it does for the ast, so forcing it runs native code instead of
+  the AST interpreter.
+
+  Literals and symbols are kept as they are, R evaluates them directly and a
+  native promise would not be any faster. If there is nothing to compile, the
+  original formals are returned, otherwise a shallow copy.
+
+  Closures compiled by jit.compile get compiled defaults as well. Closures
+  compiled when they are called (compileIC, recompileFunction) only replace
+  their body and keep the defaults of the ast, as their formals are shared
+  with the other closures of the function definition.
+ */
+SEXP Compiler::compileFormals(SEXP formals) {
+    bool hasCalls = false;
+    for (SEXP f = formals; f != R_NilValue; f = CDR(f))
+        if (TYPEOF(CAR(f)) == LANGSXP)
+            hasCalls = true;
+    if (not hasCalls)
+        return formals;
+    Protect p;
+    SEXP result = p(shallow_duplicate(formals));
+    for (SEXP f = result; f != R_NilValue; f = CDR(f))
+        if (TYPEOF(CAR(f)) == LANGSXP)
+            SETCAR(f, compilePromise("default", CAR(f)));
+    return result;
+}
+
 /** Return calls or returns in general are compiled depending on the context.
  * Usually a simple return instruction in bitcode is enough, but while in
  * promises, we must use longjmp, which is done by calling returnJump intrinsic.
@@ -1089,7 +1137,7 @@ bool Compiler::canSkipLoopContext(SEXP ast, bool breakOK) {
                        cs == symbol::While or cs == symbol::Repeat) {
                 return true;
             } else if (cs == symbol::Parenthesis or cs == symbol::Block or
-                       cs == symbol::If) {
+                       cs == symbol::If or compilesWithoutPromises(ast)) {
                 return canSkipLoopContextList(CDR(ast), breakOK);
             } else {
                 return canSkipLoopContextList(CDR(ast), false);
@@ -1106,6 +1154,30 @@ bool Compiler::canSkipLoopContext(SEXP ast, bool breakOK) {
     }
 }
 
+/** Returns true if the call is always compiled by compileIntrinsic with all
+  its arguments compiled inline, rather than into promises.
+
+  Break and next in arguments of such calls become direct jumps to the loop's
+  targets, so unlike Luke's compiler we do not need a loop context for them.
+  Calls which may fall back to the R calling mechanism (brackets, complex
+  assignments, ...) are not listed.
+ */
+bool Compiler::compilesWithoutPromises(SEXP call) {
+    SEXP cs = CAR(call);
+    SEXP args = CDR(call);
+    if (cs == symbol::Assign or cs == symbol::Assign2 or
+        cs == symbol::SuperAssign)
+        return TYPEOF(CAR(args)) == SYMSXP;
+    if (cs == symbol::Switch)
+        return args != R_NilValue;
+    return cs == symbol::Return or cs == symbol::Add or cs == symbol::Sub or
+           cs == symbol::Mul or cs == symbol::Div or cs == symbol::Pow or
+           cs == symbol::Sqrt or cs == symbol::Exp or cs == symbol::Eq or
+           cs == symbol::Ne or cs == symbol::Lt or cs == symbol::Le or
+           cs == symbol::Ge or cs == symbol::Gt or cs == symbol::BitAnd or
+           cs == symbol::BitOr or cs == symbol::Not;
+}
+
 bool Compiler::canSkipLoopContextList(SEXP ast, bool breakOK) {
     while (ast != R_NilValue) {
         if (not canSkipLoopContext(CAR(ast), breakOK))
@@ -1202,6 +1274,23 @@ Value* Compiler::compileSwitch(SEXP call) {
     }
     //
     b.addConstantPoolObject(cases);
+    // CHARSXPs are interned in the global string cache, so a control string
+    // equal to a case name is almost always the very same CHARSXP as the
+    // case's PRINTNAME. Dispatch on its address first and only fall back to
+    // the string comparing intrinsic on a miss (different encodings, NA,
+    // default case)
+    ir::Switch* swFast = nullptr;
+    if (cases != R_NilValue and caseNames.size() > 0) {
+        Value* str =
+            ir::GetVectorElement::create(b, control, b.integer(0), t::SEXP)
+                ->result();
+        Value* address = ir::SexpAddress::create(b, str)->result();
+        BasicBlock* switchCharacterSlow =
+            b.createBasicBlock("switchCharacterSlow");
+        swFast = ir::Switch::create(b, address, switchCharacterSlow,
+                                    caseNames.size());
+        b.setBlock(switchCharacterSlow);
+    }
     Value* caseCharacter =
         ir::SwitchControlCharacter::create(b, control, call, cases)->result();
 
@@ -1215,6 +1304,15 @@ Value* Compiler::compileSwitch(SEXP call) {
     // TODO: fix empty switch
     BasicBlock* last = nullptr;
     BasicBlock* fallThrough = nullptr;
+    // the first case with given name wins, later duplicates are unreachable
+    std::set<SEXP> fastCases;
+    auto addFastCase = [&](unsigned nameIdx, BasicBlock* target) {
+        if (swFast == nullptr)
+            return;
+        SEXP name = PRINTNAME(caseNames[nameIdx]);
+        if (fastCases.insert(name).second)
+            swFast->addCase(name, target);
+    };
     for (unsigned i = 0; i < caseAsts.size(); ++i) {
         last = b.createBasicBlock("switchCase");
         if (fallThrough != nullptr) {
@@ -1225,8 +1323,10 @@ Value* Compiler::compileSwitch(SEXP call) {
         swInt->addCase(i, last);
         if (defaultIdx == -1 or defaultIdx > static_cast<int>(i)) {
             swChar->addCase(i, last);
+            addFastCase(i, last);
         } else if (defaultIdx < static_cast<int>(i)) {
             swChar->addCase(i - 1, last);
+            addFastCase(i - 1, last);
         } else {
             swChar->addCase(caseAsts.size() - 1, last);
             swChar->setDefaultDest(last);
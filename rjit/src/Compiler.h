@@ -35,9 +35,14 @@ class Compiler {
     SEXP compileFunction(std::string const& name, SEXP ast, SEXP formals,
                          bool optimize = false);
 
+    /** Returns formals whose non-trivial default arguments are compiled into
+      native promise code.
+     */
+    SEXP compileFormals(SEXP formals);
+
     void finalizeCompile(SEXP ast);
 
-    void finalize();
+    void finalize(bool hot = false);
 
   private:
     // Keeps track when finalize was called
@@ -58,6 +63,11 @@ class Compiler {
       */
     llvm::Value* compileSymbol(SEXP value);
 
+    /** Records the type of value in the feedback slot of key (a symbol or a
+      call), or guards it with the feedback when optimizing.
+     */
+    void compileTypeFeedback(SEXP key, llvm::Value* value);
+
     llvm::Value* compileICCallStub(llvm::Value* call, llvm::Value* op,
                                    std::vector<llvm::Value*>& callArgs);
 
@@ -140,10 +150,7 @@ class Compiler {
     llvm::Value* compileAssignDoubleMatrix(SEXP call, SEXP vector, SEXP row,
                                            SEXP col, SEXP value, bool super);
 
-    /** Similar to R bytecode compiler, only the body of the created function is
-      compiled, the default arguments are left in their ast forms for now.
-
-      TODO this should change.
+    /** Compiles the body and the default arguments of the created function.
      */
     llvm::Value* compileFunctionDefinition(SEXP fdef);
 
@@ -226,6 +233,8 @@ class Compiler {
 
     bool canSkipLoopContextList(SEXP ast, bool breakOK);
 
+    bool compilesWithoutPromises(SEXP call);
+
     /** Helper function to determine which case store assignment and retrieval
         can handle.
     */
@@ -0,0 +1,124 @@
+#include "FastPaths.h"
+#include "GCPassApi.h"
+
+#include "ir/Builder.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace llvm;
+
+namespace rjit {
+
+std::string FastPaths::path() {
+    const char* env = getenv("RJIT_FASTPATHS");
+    if (env)
+        return env;
+#ifdef RJIT_FASTPATHS
+    return RJIT_FASTPATHS;
+#else
+    return "";
+#endif
+}
+
+Module* FastPaths::bitcode() {
+    static bool loaded = false;
+    static std::unique_ptr<Module> module;
+
+    if (loaded)
+        return module.get();
+    loaded = true;
+
+    std::string file = path();
+    if (file.empty())
+        return nullptr;
+
+    SMDiagnostic err;
+    module = parseIRFile(file, err, getGlobalContext());
+    if (!module) {
+        std::cerr << "rjit: fast paths not loaded from " << file << ": "
+                  << err.getMessage().str() << "\n";
+        return nullptr;
+    }
+
+    // Only the definitions are fast paths, the declarations are their slow
+    // paths.
+    AttrBuilder target;
+    target.addAttribute("target-cpu");
+    target.addAttribute("target-features");
+    for (Function& f : *module) {
+        if (f.isDeclaration())
+            continue;
+        // the jitted functions do not carry these, and the inliner refuses
+        // callees whose target differs from the caller
+        f.removeAttributes(
+            AttributeSet::FunctionIndex,
+            AttributeSet::get(f.getContext(), AttributeSet::FunctionIndex,
+                              target));
+        f.addFnAttr(Attribute::AlwaysInline);
+        f.setLinkage(GlobalValue::AvailableExternallyLinkage);
+        for (BasicBlock& b : f)
+            for (Instruction& i : b) {
+                CallInst* call = dyn_cast<CallInst>(&i);
+                if (call && call->getCalledFunction() &&
+                    call->getCalledFunction()->isDeclaration())
+                    ir::Builder::markSafepoint(call);
+            }
+    }
+    return module.get();
+}
+
+void FastPaths::link(Module* m) {
+    Module* fastPaths = bitcode();
+    if (!fastPaths)
+        return;
+
+    bool used = false;
+    for (Function& f : *fastPaths) {
+        if (f.isDeclaration())
+            continue;
+        Function* callee = m->getFunction(f.getName());
+        if (callee && callee->isDeclaration() && !callee->use_empty()) {
+            used = true;
+            break;
+        }
+    }
+    if (!used)
+        return;
+
+    // The linker consumes its source, the parsed bitcode is kept for the next
+    // module.
+    std::unique_ptr<Module> copy(CloneModule(fastPaths));
+    bool failed = Linker::LinkModules(m, copy.get());
+    assert(!failed && "Fast paths do not link with the module");
+    (void)failed;
+}
+
+namespace {
+
+/** Links the fast paths into the module (see FastPaths::link).
+ */
+struct LinkFastPaths : public ModulePass {
+    static char ID;
+
+    LinkFastPaths() : ModulePass(ID) {}
+
+    bool runOnModule(Module& m) override {
+        size_t before = m.getFunctionList().size();
+        FastPaths::link(&m);
+        return m.getFunctionList().size() != before;
+    }
+};
+
+char LinkFastPaths::ID = 0;
+}
+
+ModulePass* rjit::createFastPathsPass() { return new LinkFastPaths(); }
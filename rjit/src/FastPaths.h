@@ -0,0 +1,46 @@
+#ifndef FAST_PATHS_H
+#define FAST_PATHS_H
+
+#include <llvm/IR/Module.h>
+
+#include <memory>
+#include <string>
+
+namespace rjit {
+
+/** Fast paths of intrinsics, pre-built as LLVM bitcode.
+
+  The bitcode is compiled from fastpaths/intrinsics.c by clang at build time.
+  Its location is baked in as RJIT_FASTPATHS and can be overridden by the
+  RJIT_FASTPATHS environment variable, an empty value disables the fast
+  paths. Without the bitcode modules are compiled as before.
+
+  The bitcode is parsed once. A copy of it is linked into the module by the
+  createFastPathsPass module pass, after the rjit ir passes and before the
+  llvm optimizations. The fast paths become available_externally always
+  inline definitions of the intrinsics, so that the inliner replaces the
+  calls, while the definitions themselves are never emitted and calls which
+  are not inlined still resolve to gnur.
+ */
+class FastPaths {
+  public:
+    /** Links the fast paths into m, if m calls any of them.
+
+      The rjit ir passes recognize intrinsics by their calls and must not
+      see the linked definitions, hence linking is a pass scheduled after
+      them. The calls stay in place until the always inliner runs.
+     */
+    static void link(llvm::Module* m);
+
+    /** Returns true if the fast paths were loaded.
+     */
+    static bool available() { return bitcode() != nullptr; }
+
+  private:
+    static llvm::Module* bitcode();
+
+    static std::string path();
+};
+}
+
+#endif
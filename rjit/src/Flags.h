@@ -21,6 +21,8 @@ class Flag {
     bool compileMatrixRead = true;
     bool compileMatrixWrite = true;
     bool compileSuperMatrixWrite = true;
+    bool profile = false;
+    bool countIntrinsics = false;
 };
 }
 
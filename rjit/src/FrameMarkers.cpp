@@ -0,0 +1,92 @@
+#include "GCPassApi.h"
+#include "ir/primitive_calls.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
+
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+
+/** Brackets every rjit function with pushFrameMarker and popFrameMarker calls.
+
+  The marker (see FrameMarker in StackScan.h) is pushed together with the
+  stack pointer right after the static allocas. It writes a stamp into a
+  canary slot allocated in the entry block, which identifies the frame and
+  tells the scanner whether the frame was overwritten after a longjmp. As
+  rjit functions have no dynamic allocas and reserve their call frames, the
+  stack pointer stays the same at every call the function makes, so the
+  statepoint spill offsets can be applied to it directly.
+
+  A longjmp to the context of a closure call lands in its trampoline, which
+  returns to the calling frame. That frame then unwinds the markers of the
+  frames the longjmp left, before the context is ended.
+
+  The calls are not safepoints, they have to run after the optimizations
+  (so that nothing gets inlined into the bracketed code) and before the
+  safepoints are placed.
+ */
+struct FrameMarkers : public FunctionPass {
+    static char ID;
+
+    FrameMarkers() : FunctionPass(ID) {}
+
+    bool runOnFunction(Function& f) override {
+        if (!f.hasGC() or std::string(f.getGC()) != "rjit")
+            return false;
+
+        Module* m = f.getParent();
+        LLVMContext& c = f.getContext();
+        Type* i64 = Type::getInt64Ty(c);
+        Type* i64p = Type::getInt64PtrTy(c);
+
+        Function* push = cast<Function>(m->getOrInsertFunction(
+            "pushFrameMarker",
+            FunctionType::get(Type::getVoidTy(c), {i64p, i64}, false)));
+        Function* pop = cast<Function>(m->getOrInsertFunction(
+            "popFrameMarker",
+            FunctionType::get(Type::getVoidTy(c), {i64p}, false)));
+        Function* unwind = cast<Function>(m->getOrInsertFunction(
+            "unwindFrameMarkers",
+            FunctionType::get(Type::getVoidTy(c), {i64p}, false)));
+        Function* stacksave =
+            Intrinsic::getDeclaration(m, Intrinsic::stacksave);
+
+        BasicBlock& entry = f.getEntryBlock();
+        auto canary = new AllocaInst(i64, "frameCanary", &*entry.begin());
+        BasicBlock::iterator ip = entry.begin();
+        while (isa<AllocaInst>(&*ip))
+            ++ip;
+        auto sp = CallInst::Create(stacksave, "", &*ip);
+        auto spInt = new PtrToIntInst(sp, i64, "", &*ip);
+        CallInst::Create(push, {canary, spInt}, "", &*ip);
+
+        StringRef trampoline =
+            rjit::ir::ClosureNativeCallTrampoline::intrinsicName();
+        std::vector<CallInst*> trampolines;
+        for (BasicBlock& b : f)
+            for (Instruction& i : b)
+                if (auto call = dyn_cast<CallInst>(&i))
+                    if (call->getCalledFunction() &&
+                        call->getCalledFunction()->getName() == trampoline)
+                        trampolines.push_back(call);
+        for (CallInst* call : trampolines) {
+            auto after = CallInst::Create(unwind, {canary});
+            after->insertAfter(call);
+        }
+
+        for (BasicBlock& b : f)
+            if (auto r = dyn_cast<ReturnInst>(b.getTerminator()))
+                CallInst::Create(pop, {canary}, "", r);
+        return true;
+    }
+};
+
+char FrameMarkers::ID = 0;
+}
+
+FunctionPass* rjit::createFrameMarkersPass() { return new FrameMarkers(); }
@@ -8,6 +8,9 @@ namespace rjit {
 
 llvm::FunctionPass* createPlaceRJITSafepointsPass();
 llvm::ModulePass* createRJITRewriteStatepointsForGCPass();
+llvm::FunctionPass* createFrameMarkersPass();
+llvm::FunctionPass* createIntrinsicCountersPass();
+llvm::ModulePass* createFastPathsPass();
 }
 
 #endif
@@ -26,6 +26,8 @@
 #include "StackMap.h"
 #include "StackMapParser.h"
 #include "CodeCache.h"
+#include "CodeRegion.h"
+#include "CompilePolicy.h"
 #include "ir/Builder.h"
 #include "ir/primitive_calls.h"
 #include "ir/Ir.h"
@@ -79,12 +81,17 @@ void* ICCompiler::getSpecialIC(unsigned size) {
         ir::Builder b("ic");
         ICCompiler compiler(size, b, specialName(size));
         compiler.compileSpecialIC();
-        return (uint64_t)compiler.finalize();
+        void* ic = compiler.finalize();
+        // shared by all call sites
+        CodeRegion::find((uintptr_t)ic)->pin();
+        return (uint64_t)ic;
     });
 }
 
-void* ICCompiler::compile(SEXP inCall, SEXP inFun, SEXP inRho) {
+void* ICCompiler::compile(SEXP inCall, SEXP inFun, SEXP inRho,
+                          bool deferred) {
     assert(TYPEOF(inFun) != SPECIALSXP);
+    this->deferred = deferred;
 
     b.openIC(name, ic_t);
 
@@ -102,7 +109,7 @@ void* ICCompiler::finalize() {
     // FIXME: return nativesxp and not naked ptr?
     auto f = b.closeIC();
 
-    auto engine = JITCompileLayer::singleton.finalize(b);
+    auto engine = JITCompileLayer::singleton.finalize(b, true);
     auto ic = engine->getPointerToFunction(f);
 
     if (!RJIT_DEBUG)
@@ -117,10 +124,10 @@ Function* ICCompiler::compileCallStub() {
     Value* icAddr =
         ir::CompileIC::create(
             b, ConstantInt::get(getGlobalContext(), APInt(64, size)), call(),
-            fun(), rho(), stackmapId())
+            fun(), rho(), icSlot())
             ->result();
 
-    ir::PatchIC::create(b, icAddr, stackmapId(), caller());
+    ir::PatchIC::create(b, icAddr, icSlot(), caller());
 
     // TODO adding llvm instruction directly w/o builder is not such a good idea
     Value* ic = new BitCastInst(icAddr, PointerType::get(ic_t, 0), "", b);
@@ -320,6 +327,24 @@ bool ICCompiler::compileGenericIc(SEXP inCall, SEXP inFun) {
         break;
     }
     case CLOSXP: {
+        if (deferred) {
+            // the counter lives in the module, it is freed with the ic
+            Type* i32 = Type::getInt32Ty(getGlobalContext());
+            auto calls = new GlobalVariable(
+                *b.module(), i32, false, GlobalValue::InternalLinkage,
+                ConstantInt::get(i32, 0), "calls");
+            Value* n = new LoadInst(calls, "", b.block());
+            n = BinaryOperator::Create(Instruction::Add, n,
+                                       ConstantInt::get(i32, 1), "",
+                                       b.block());
+            new StoreInst(n, calls, b.block());
+            Value* hot = new ICmpInst(
+                *b.block(), ICmpInst::ICMP_UGE, n,
+                ConstantInt::get(i32, CompilePolicy::deferredCalls), "hot");
+            BasicBlock* icCall = b.createBasicBlock("icCall");
+            BranchInst::Create(icMiss, icCall, hot, b.block());
+            b.setBlock(icCall);
+        }
         Value* args = compileArguments(CDR(inCall), /*eager=*/false);
         res = ir::CallClosure::create(b, call(), fun(), args, rho())->result();
         break;
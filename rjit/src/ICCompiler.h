@@ -14,7 +14,11 @@ class ICCompiler {
     static llvm::Function* getStub(unsigned size, ir::Builder& b);
     static void* getSpecialIC(unsigned size);
 
-    void* compile(SEXP inCall, SEXP inFun, SEXP inRho);
+    /** Compiles an IC for calls of inFun. If the compilation of its body was
+      deferred, the IC counts the calls and misses once the body got hot, so
+      that compileIC is asked again.
+     */
+    void* compile(SEXP inCall, SEXP inFun, SEXP inRho, bool deferred = false);
 
     static std::string stubName(unsigned size);
     static std::string specialName(unsigned size);
@@ -24,7 +28,7 @@ class ICCompiler {
     llvm::Value* fun() { return b.args().at(size + 1); }
     llvm::Value* rho() { return b.rho(); }
     llvm::Value* caller() { return b.args().at(size + 3); }
-    llvm::Value* stackmapId() { return b.args().at(size + 4); }
+    llvm::Value* icSlot() { return b.args().at(size + 4); }
 
     void* finalize();
 
@@ -60,6 +64,7 @@ class ICCompiler {
     ir::Builder& b;
     unsigned size;
     std::string name;
+    bool deferred = false;
 };
 
 } // namespace rjit
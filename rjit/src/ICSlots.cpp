@@ -0,0 +1,28 @@
+#include "ICSlots.h"
+
+namespace rjit {
+
+std::vector<std::unique_ptr<ICSlots::Slot[]>> ICSlots::chunks;
+size_t ICSlots::used = chunkSize;
+std::vector<ICSlots::Slot*> ICSlots::freeSlots;
+
+ICSlots::Slot* ICSlots::allocate() {
+    if (!freeSlots.empty()) {
+        Slot* slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+    if (used == chunkSize) {
+        chunks.emplace_back(new Slot[chunkSize]);
+        used = 0;
+    }
+    Slot* slot = &chunks.back()[used++];
+    slot->store(nullptr, std::memory_order_relaxed);
+    return slot;
+}
+
+void ICSlots::free(Slot* slot) {
+    slot->store(nullptr, std::memory_order_relaxed);
+    freeSlots.push_back(slot);
+}
+}
@@ -0,0 +1,38 @@
+#ifndef IC_SLOTS_H
+#define IC_SLOTS_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace rjit {
+
+/** Call targets of the IC call sites.
+
+  Every IC call site loads its target from a slot of its own and calls it
+  indirectly. Retargeting a call site to a new IC is therefore a single atomic
+  store to its slot, the code itself is never patched. Slots are allocated in
+  chunks, which are never moved, and freed slots are reused.
+ */
+class ICSlots {
+  public:
+    typedef std::atomic<void*> Slot;
+
+    static Slot* allocate();
+
+    static void free(Slot* slot);
+
+  private:
+    static constexpr size_t chunkSize = 4096;
+
+    static std::vector<std::unique_ptr<Slot[]>> chunks;
+
+    /** Number of slots used in the last chunk.
+     */
+    static size_t used;
+
+    static std::vector<Slot*> freeSlots;
+};
+}
+
+#endif
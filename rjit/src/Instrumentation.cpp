@@ -8,32 +8,67 @@
 
 #include <iostream>
 #include <cassert>
+#include <new>
 
 namespace rjit {
 
+FeedbackSlot* FeedbackSlot::slots(SEXP store) {
+    assert(TYPEOF(store) == INTSXP);
+    return reinterpret_cast<FeedbackSlot*>(INTEGER(store));
+}
+
+size_t FeedbackSlot::count(SEXP store) {
+    assert(XLENGTH(store) % slotSize == 0);
+    return XLENGTH(store) / slotSize;
+}
+
+SEXP FeedbackSlot::allocate(size_t n) {
+    SEXP store = allocVector(INTSXP, n * slotSize);
+    FeedbackSlot* s = slots(store);
+    for (size_t i = 0; i < n; ++i)
+        new (&s[i]) FeedbackSlot();
+    return store;
+}
+
 TypeRecorder::TypeRecorder(SEXP store) : store(store) {
     assert(TYPEOF(store) == INTSXP);
 }
 
 void TypeRecorder::record(SEXP value, int idx) {
-    assert(idx < XLENGTH(store));
-
-    TypeInfo old_info(INTEGER(store)[idx]);
-    TypeInfo info(INTEGER(store)[idx]);
+    assert(idx < (int)FeedbackSlot::count(store));
+    FeedbackSlot& slot = FeedbackSlot::slots(store)[idx];
+    bool first = slot.profile.length() == ValueProfile::Length::Unknown;
 
+    TypeInfo info(slot.info);
     info.mergeAll(value);
+    if (info != slot.info)
+        slot.info = info;
 
-    if (old_info != info) {
-        INTEGER(store)[idx] = static_cast<int>(info);
-    }
+    slot.profile.merge(value);
+
+    int type = TYPEOF(value);
+    if (ATTRIB(value) == R_NilValue && slot.profile.fixedLength() >= 0 &&
+        (first || slot.seenType == type))
+        slot.seenType = type;
+    else
+        slot.seenType = -1;
 }
 
 TypeFeedback::TypeFeedback(SEXP native) : native(native) {
     assert(TYPEOF(native) == NATIVESXP);
+    SEXP names = VECTOR_ELT(cp(), 2);
+    assert(TYPEOF(names) == VECSXP);
+    assert(FeedbackSlot::count(VECTOR_ELT(cp(), 1)) == (size_t)XLENGTH(names));
+    for (int i = 0; i < XLENGTH(names); ++i)
+        slotsByKey[VECTOR_ELT(names, i)].push_back(i);
 }
 
 SEXP TypeFeedback::cp() { return CDR(native); }
 
+FeedbackSlot* TypeFeedback::slots() {
+    return FeedbackSlot::slots(VECTOR_ELT(cp(), 1));
+}
+
 void TypeFeedback::clearInvocationCount() {
     SEXP invocationCount = VECTOR_ELT(cp(), 3);
     INTEGER(invocationCount)[0] = 0;
@@ -43,18 +78,64 @@ namespace {
 static char const* const MD_NAME = "rjit_typefeedback_node";
 }
 
-TypeInfo TypeFeedback::get(SEXP sym) {
-    SEXP store = VECTOR_ELT(cp(), 1);
-    SEXP names = VECTOR_ELT(cp(), 2);
-    assert(TYPEOF(store) == INTSXP);
-    assert(TYPEOF(names) == VECSXP);
-    assert(XLENGTH(store) == XLENGTH(names));
-    for (unsigned i = 0; i < XLENGTH(store); ++i) {
-        if (VECTOR_ELT(names, i) == sym) {
-            return TypeInfo(INTEGER(store)[i]);
+int TypeFeedback::nextSlot(SEXP key) {
+    auto i = slotsByKey.find(key);
+    if (i == slotsByKey.end())
+        return -1;
+    size_t& site = sitesSeen[key];
+    if (site == i->second.size())
+        return -1;
+    return i->second[site++];
+}
+
+void TypeFeedback::bind(llvm::Value* value, int slot) { bound[value] = slot; }
+
+void TypeFeedback::guard(llvm::Instruction* check, int slot) {
+    checks.push_back({check, slot});
+}
+
+void TypeFeedback::checkSites() {
+    for (auto& key : slotsByKey) {
+        if (sitesSeen[key.first] == key.second.size())
+            continue;
+        FeedbackSlot all;
+        for (int slot : key.second) {
+            all.info = TypeInfo::merge(all.info, slots()[slot].info);
+            all.profile.merge(slots()[slot].profile);
         }
+        for (int slot : key.second)
+            merged[slot] = all;
     }
-    return TypeInfo::any();
+
+    for (auto& c : checks) {
+        auto m = merged.find(c.second);
+        if (m == merged.end())
+            continue;
+        auto check = llvm::cast<llvm::CallInst>(c.first);
+        check->setArgOperand(
+            1, llvm::ConstantInt::get(check->getArgOperand(1)->getType(),
+                                      static_cast<int>(m->second.info)));
+    }
+}
+
+TypeInfo TypeFeedback::get(int slot) {
+    auto m = merged.find(slot);
+    return m == merged.end() ? slots()[slot].info : m->second.info;
+}
+
+ValueProfile TypeFeedback::profile(int slot) {
+    auto m = merged.find(slot);
+    return m == merged.end() ? slots()[slot].profile : m->second.profile;
+}
+
+TypeInfo TypeFeedback::get(llvm::Value* value) {
+    auto i = bound.find(value);
+    return i == bound.end() ? TypeInfo::any() : get(i->second);
+}
+
+ValueProfile TypeFeedback::profile(llvm::Value* value) {
+    auto i = bound.find(value);
+    return i == bound.end() ? ValueProfile() : profile(i->second);
 }
 
 void TypeFeedback::attach(llvm::Function* f) {
@@ -95,7 +176,11 @@ extern "C" void checkType(SEXP value, rjit::TypeInfo expected) {
     assert(changed == expected);
 }
 
-extern "C" void recordType(SEXP value, SEXP store, int idx) {
+extern "C" void recordTypeSlow(SEXP value, SEXP store, int idx) {
     rjit::TypeRecorder record(store);
     record.record(value, idx);
 }
+
+extern "C" void recordType(SEXP value, SEXP store, int idx) {
+    recordTypeSlow(value, store, idx);
+}
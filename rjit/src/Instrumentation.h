@@ -6,8 +6,44 @@
 
 #include <llvm/IR/Function.h>
 
+#include <unordered_map>
+#include <vector>
+
 namespace rjit {
 
+/** One slot of the typefeedback vector in the constant pool of a function.
+
+  The vector is an INTSXP of slotSize ints per slot. The fast path of
+  recordType in fastpaths/intrinsics.c reads the slot directly, its layout
+  must be kept in sync.
+ */
+struct FeedbackSlot {
+    TypeInfo info;
+    ValueProfile profile;
+
+    /** The SEXPTYPE of all recorded values while they all were vectors of the
+      same length and without attributes, -1 once they were not.
+
+      Another such value can only change the value profile, which the fast
+      path checks for scalars. Everything else takes the slow path.
+     */
+    int seenType = -1;
+
+    static constexpr int slotSize = 5;
+
+    static FeedbackSlot* slots(SEXP store);
+    static size_t count(SEXP store);
+
+    /** Allocates the typefeedback vector of a function with n empty slots.
+     */
+    static SEXP allocate(size_t n);
+};
+
+static_assert(sizeof(FeedbackSlot) == FeedbackSlot::slotSize * sizeof(int),
+              "FeedbackSlot must match the layout of the typefeedback vector");
+
+/** Records value in the slot, whether it changes or not.
+ */
 class TypeRecorder {
   public:
     TypeRecorder(SEXP store);
@@ -19,10 +55,44 @@ class TypeRecorder {
 
 class TypeFeedback {
   public:
+    /** Indexes the feedback slots of native by their keys.
+     */
     TypeFeedback(SEXP native);
 
     void clearInvocationCount();
-    TypeInfo get(SEXP symbol);
+
+    /** Returns the slot of the next read site of key, or -1 if there is none.
+
+      The sites of a key get their slots in the order they are compiled, which
+      is the same when the function is compiled again from the same AST.
+     */
+    int nextSlot(SEXP key);
+
+    /** Associates the value the code of a read site produces with its slot.
+     */
+    void bind(llvm::Value* value, int slot);
+
+    /** Remembers the checkType call which guards the feedback of slot.
+     */
+    void guard(llvm::Instruction* check, int slot);
+
+    /** Verifies that every key had as many read sites as it has slots, once
+      the function is compiled.
+
+      The sites of a key are matched with its slots by their order only. If
+      the counts differ (the AST changed since the feedback was recorded),
+      every site of the key gets the merged feedback of all its slots and
+      their type checks are widened to it.
+     */
+    void checkSites();
+
+    TypeInfo get(int slot);
+    ValueProfile profile(int slot);
+
+    /** Feedback of the read site whose value is given, any if it has none.
+     */
+    TypeInfo get(llvm::Value* value);
+    ValueProfile profile(llvm::Value* value);
 
     void attach(llvm::Function* f);
     static TypeFeedback* get(llvm::Function* f);
@@ -30,11 +100,21 @@ class TypeFeedback {
 
   private:
     SEXP cp();
+    FeedbackSlot* slots();
     SEXP native;
+
+    std::unordered_map<SEXP, std::vector<int>> slotsByKey;
+    std::unordered_map<SEXP, size_t> sitesSeen;
+    std::unordered_map<llvm::Value*, int> bound;
+    std::vector<std::pair<llvm::Instruction*, int>> checks;
+    std::unordered_map<int, FeedbackSlot> merged;
 };
 }
 
 extern "C" void recordType(SEXP value, SEXP store, int idx);
+/** Slow path of the recordType fast path (fastpaths/intrinsics.c).
+ */
+extern "C" void recordTypeSlow(SEXP value, SEXP store, int idx);
 extern "C" void checkType(SEXP value, rjit::TypeInfo idx);
 
 #endif
@@ -0,0 +1,238 @@
+#include "IntrinsicCounters.h"
+#include "CodeSymbols.h"
+#include "GCPassApi.h"
+#include "JITModule.h"
+#include "Protect.h"
+
+#include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+using namespace llvm;
+
+namespace rjit {
+
+thread_local IntrinsicCounters::Local* IntrinsicCounters::local = nullptr;
+std::mutex IntrinsicCounters::lock;
+std::vector<IntrinsicCounters::Local*> IntrinsicCounters::threads;
+std::vector<uint64_t> IntrinsicCounters::exited;
+std::vector<IntrinsicCounters::Site> IntrinsicCounters::sites;
+std::vector<unsigned> IntrinsicCounters::freeSites;
+std::unordered_map<llvm::Function*, std::vector<unsigned>>
+    IntrinsicCounters::pending;
+
+unsigned IntrinsicCounters::allocate(std::string const& intrinsic,
+                                     llvm::Function* f,
+                                     std::string const& function,
+                                     unsigned index) {
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned site;
+    if (freeSites.empty()) {
+        site = sites.size();
+        sites.push_back({});
+        exited.push_back(0);
+    } else {
+        site = freeSites.back();
+        freeSites.pop_back();
+    }
+    sites[site] = {intrinsic, function, index, 0, true};
+    pending[f].push_back(site);
+    return site;
+}
+
+void IntrinsicCounters::finalize(JITModule* m, ExecutionEngine* engine) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (Function& f : m->getFunctionList()) {
+        auto i = pending.find(&f);
+        if (i == pending.end())
+            continue;
+        auto code = (uintptr_t)engine->getPointerToFunction(&f);
+        for (unsigned site : i->second)
+            sites[site].code = code;
+        pending.erase(i);
+    }
+}
+
+void IntrinsicCounters::unregister(uintptr_t begin, uintptr_t end) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (unsigned site = 0; site < sites.size(); ++site) {
+        Site& s = sites[site];
+        if (!s.live || s.code < begin || s.code >= end)
+            continue;
+        s = {};
+        sum(site, true);
+        freeSites.push_back(site);
+    }
+}
+
+IntrinsicCounters::Counters IntrinsicCounters::allocateCounters(size_t size) {
+    void* counters = nullptr;
+    int error =
+        posix_memalign(&counters, alignof(Counter), size * sizeof(Counter));
+    assert(!error && "Cannot allocate counters");
+    (void)error;
+    Counters result(static_cast<Counter*>(counters));
+    for (size_t i = 0; i < size; ++i)
+        new (result.get() + i) Counter();
+    return result;
+}
+
+IntrinsicCounters::Local* IntrinsicCounters::grow(unsigned site) {
+    static thread_local Local owner;
+    std::lock_guard<std::mutex> guard(lock);
+    if (local == nullptr) {
+        local = &owner;
+        threads.push_back(local);
+    }
+    // all sites allocated so far fit, so that growing is rare
+    size_t size = std::max<size_t>(site + 1, sites.size());
+    Counters counters = allocateCounters(size);
+    std::copy(local->counters.get(), local->counters.get() + local->size,
+              counters.get());
+    local->counters = std::move(counters);
+    local->size = size;
+    return local;
+}
+
+IntrinsicCounters::Local::~Local() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t site = 0; site < size; ++site)
+        exited[site] += counters[site].count;
+    threads.erase(std::find(threads.begin(), threads.end(), this));
+    local = nullptr;
+}
+
+uint64_t IntrinsicCounters::sum(unsigned site, bool reset) {
+    uint64_t result = exited[site];
+    if (reset)
+        exited[site] = 0;
+    for (Local* l : threads) {
+        if (site >= l->size)
+            continue;
+        result += l->counters[site].count;
+        if (reset)
+            l->counters[site].count = 0;
+    }
+    return result;
+}
+
+SEXP IntrinsicCounters::report() {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<unsigned> live;
+    for (unsigned site = 0; site < sites.size(); ++site)
+        if (sites[site].live)
+            live.push_back(site);
+    int n = live.size();
+
+    Protect p;
+    SEXP result = p(allocVector(VECSXP, 4));
+    SEXP intrinsic = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 0, intrinsic);
+    SEXP function = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 1, function);
+    SEXP index = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, 2, index);
+    // counts can exceed the range of R integers
+    SEXP count = allocVector(REALSXP, n);
+    SET_VECTOR_ELT(result, 3, count);
+    for (int i = 0; i < n; ++i) {
+        Site& s = sites[live[i]];
+        SET_STRING_ELT(intrinsic, i, mkChar(s.intrinsic.c_str()));
+        SET_STRING_ELT(function, i, mkChar(s.function.c_str()));
+        INTEGER(index)[i] = s.index;
+        REAL(count)[i] = sum(live[i], false);
+    }
+
+    SEXP names = p(allocVector(STRSXP, 4));
+    SET_STRING_ELT(names, 0, mkChar("intrinsic"));
+    SET_STRING_ELT(names, 1, mkChar("function"));
+    SET_STRING_ELT(names, 2, mkChar("site"));
+    SET_STRING_ELT(names, 3, mkChar("count"));
+    setAttrib(result, R_NamesSymbol, names);
+    SEXP rowNames = p(allocVector(INTSXP, 2));
+    INTEGER(rowNames)[0] = NA_INTEGER;
+    INTEGER(rowNames)[1] = -n;
+    setAttrib(result, R_RowNamesSymbol, rowNames);
+    setAttrib(result, R_ClassSymbol, mkString("data.frame"));
+    return result;
+}
+
+void IntrinsicCounters::reset() {
+    std::lock_guard<std::mutex> guard(lock);
+    for (unsigned site = 0; site < sites.size(); ++site)
+        sum(site, true);
+}
+}
+
+extern "C" void countIntrinsic(uint64_t site) {
+    rjit::IntrinsicCounters::count(site);
+}
+
+namespace {
+
+/** Counts the executions of every intrinsic and IC call of rjit functions.
+
+  Runs after the optimizations, so that only calls which survived them are
+  counted, and before the safepoints are placed. The countIntrinsic calls it
+  inserts are not safepoints.
+ */
+struct IntrinsicCountersPass : public FunctionPass {
+    static char ID;
+
+    IntrinsicCountersPass() : FunctionPass(ID) {}
+
+    bool runOnFunction(Function& f) override {
+        if (!f.hasGC() or std::string(f.getGC()) != "rjit")
+            return false;
+
+        LLVMContext& c = f.getContext();
+        Type* i64 = Type::getInt64Ty(c);
+        Function* count = cast<Function>(f.getParent()->getOrInsertFunction(
+            "countIntrinsic",
+            FunctionType::get(Type::getVoidTy(c), {i64}, false)));
+
+        std::string name = f.getName().str();
+        auto m = static_cast<JITModule*>(f.getParent());
+        if (SEXP native = m->nativeSXP(&f)) {
+            std::string location =
+                rjit::CodeSymbols::location(VECTOR_ELT(CDR(native), 0));
+            if (!location.empty())
+                name += " " + location;
+        }
+
+        std::vector<CallInst*> calls;
+        for (BasicBlock& b : f)
+            for (Instruction& i : b)
+                if (auto call = dyn_cast<CallInst>(&i))
+                    if (!call->getCalledFunction() ||
+                        (call->getCalledFunction()->isDeclaration() &&
+                         !call->getCalledFunction()->isIntrinsic()))
+                        calls.push_back(call);
+
+        unsigned index = 0;
+        for (CallInst* call : calls) {
+            Function* callee = call->getCalledFunction();
+            // IC call sites call the target loaded from their slot
+            std::string intrinsic = callee ? callee->getName().str() : "ic";
+            unsigned site = rjit::IntrinsicCounters::allocate(
+                intrinsic, &f, name, index++);
+            CallInst::Create(count, {ConstantInt::get(i64, site)}, "", call);
+        }
+        return !calls.empty();
+    }
+};
+
+char IntrinsicCountersPass::ID = 0;
+}
+
+FunctionPass* rjit::createIntrinsicCountersPass() {
+    return new IntrinsicCountersPass();
+}
@@ -0,0 +1,124 @@
+#ifndef INTRINSIC_COUNTERS_H
+#define INTRINSIC_COUNTERS_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RDefs.h"
+
+namespace llvm {
+class ExecutionEngine;
+class Function;
+}
+
+class JITModule;
+
+namespace rjit {
+
+/** Execution counts of the intrinsic calls of the jitted code.
+
+  When the countIntrinsics flag is set, a late pass (see
+  createIntrinsicCountersPass) calls countIntrinsic with the id of the call
+  site before every call of an intrinsic or an IC. Every thread counts into
+  counters of its own, each on its own cache line, so that counting hot call
+  sites neither contends with other threads nor disturbs the cache lines of
+  other counters. The report sums the counters of all threads.
+
+  Sites are freed together with their code, their ids are then reused.
+ */
+class IntrinsicCounters {
+  public:
+    /** Returns the id of a new call site of given intrinsic in function f.
+     */
+    static unsigned allocate(std::string const& intrinsic,
+                             llvm::Function* f, std::string const& function,
+                             unsigned index);
+
+    /** Binds the sites of the functions of a finalized module to the address
+      of their code.
+     */
+    static void finalize(JITModule* m, llvm::ExecutionEngine* engine);
+
+    /** Frees the sites of the code in the given range, called when the code
+      is freed.
+     */
+    static void unregister(uintptr_t begin, uintptr_t end);
+
+    static void count(unsigned site) {
+        Local* l = local;
+        if (l == nullptr or site >= l->size)
+            l = grow(site);
+        l->counters[site].count++;
+    }
+
+    /** Returns a data frame with the count of each call site.
+     */
+    static SEXP report();
+
+    static void reset();
+
+  private:
+    struct alignas(64) Counter {
+        uint64_t count = 0;
+    };
+
+    /** Counters are over-aligned, they are allocated raw.
+     */
+    struct Free {
+        void operator()(Counter* c) { ::free(c); }
+    };
+    typedef std::unique_ptr<Counter[], Free> Counters;
+
+    static Counters allocateCounters(size_t size);
+
+    /** Counters of one thread, indexed by the site id.
+     */
+    struct Local {
+        Counters counters;
+        size_t size = 0;
+        ~Local();
+    };
+
+    struct Site {
+        std::string intrinsic;
+        std::string function;
+        unsigned index;
+        /** Start of the code of the function, 0 until it is finalized.
+         */
+        uintptr_t code;
+        bool live;
+    };
+
+    /** Grows the counters of the current thread to contain site.
+     */
+    static Local* grow(unsigned site);
+
+    /** Sums the counts of all threads for site and zeroes them if reset.
+     */
+    static uint64_t sum(unsigned site, bool reset);
+
+    static thread_local Local* local;
+
+    /** Guards the sites and the counters of all threads, the counters are
+      only modified without it by their own thread.
+     */
+    static std::mutex lock;
+    static std::vector<Local*> threads;
+    /** Counts of threads which have exited.
+     */
+    static std::vector<uint64_t> exited;
+
+    static std::vector<Site> sites;
+    static std::vector<unsigned> freeSites;
+    static std::unordered_map<llvm::Function*, std::vector<unsigned>> pending;
+};
+}
+
+extern "C" void countIntrinsic(uint64_t site);
+
+#endif
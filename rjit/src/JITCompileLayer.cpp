@@ -7,7 +7,12 @@
 #include "JITSymbolResolver.h"
 #include "StackMap.h"
 #include "CodeCache.h"
+#include "CodeRegion.h"
+#include "CodeSymbols.h"
+#include "FastPaths.h"
 #include "Instrumentation.h"
+#include "IntrinsicCounters.h"
+#include "Profiler.h"
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
@@ -33,14 +38,15 @@
 #include "llvm/IR/IRPrintingPasses.h"
 
 #include "Flags.h"
+#include "api.h"
 
 using namespace llvm;
 
 namespace rjit {
 
-ExecutionEngine* JITCompileLayer::finalize(JITModule* m) {
+ExecutionEngine* JITCompileLayer::finalize(JITModule* m, bool hot) {
     // to the function tells DynamicLibrary to load the program, not a library.
-    auto mm = new JITMemoryManager();
+    auto mm = new JITMemoryManager(hot);
 
     // create execution engine and finalize the module
     std::string err;
@@ -80,6 +86,12 @@ ExecutionEngine* JITCompileLayer::finalize(JITModule* m) {
     if (Flag::singleton().printOptIR)
         pm.add(createPrintModulePass(rso));
 
+    // the intrinsics are recognized by their calls up to here
+    if (FastPaths::available()) {
+        pm.add(rjit::createFastPathsPass());
+        pm.add(createAlwaysInlinerPass());
+    }
+
     pm.add(createTargetTransformInfoWrapperPass(TargetIRAnalysis()));
 
     PassManagerBuilder PMBuilder;
@@ -87,15 +99,34 @@ ExecutionEngine* JITCompileLayer::finalize(JITModule* m) {
     PMBuilder.SizeLevel = 1; // so that no additional phases are run.
     PMBuilder.populateModulePassManager(pm);
 
+    if (Flag::singleton().countIntrinsics)
+        pm.add(rjit::createIntrinsicCountersPass());
+    if (RJIT_FRAME_MARKERS)
+        pm.add(rjit::createFrameMarkersPass());
     pm.add(rjit::createPlaceRJITSafepointsPass());
     pm.add(rjit::createRJITRewriteStatepointsForGCPass());
 
-    pm.run(*m);
+    {
+        // the rjit passes account for their own time
+        Profiler::Timer timer(m, "llvm");
+        pm.run(*m);
+    }
 
     std::cout << rso.str();
 
-    engine->finalizeObject();
-    m->finalizeNativeSEXPs(engine);
+    engine->RegisterJITEventListener(&CodeSymbols::singleton);
+    {
+        Profiler::Timer timer(m, "codegen");
+        engine->finalizeObject();
+    }
+
+    std::vector<sys::MemoryBlock> code, data;
+    mm->takeMemory(code, data);
+    auto region = new CodeRegion(code, data);
+
+    m->finalizeNativeSEXPs(engine, region);
+    CodeSymbols::singleton.finalize(m);
+    IntrinsicCounters::finalize(m, engine);
 
     // Fill in addresses for cached code
     for (llvm::Function& f : m->getFunctionList()) {
@@ -104,24 +135,31 @@ ExecutionEngine* JITCompileLayer::finalize(JITModule* m) {
         if (CodeCache::missingAddress(f.getName())) {
             CodeCache::setAddress(f.getName(),
                                   (uint64_t)engine->getPointerToFunction(&f));
+            region->pin();
         }
     }
 
-    recordStackmaps(engine, m, mm);
+    {
+        Profiler::Timer timer(m, "stackmaps");
+        recordStackmaps(engine, m, mm);
+    }
 
-    // patch initial icStubs
-    for (auto p : safepoints) {
-        auto f = (uintptr_t)engine->getPointerToFunction(std::get<0>(p));
-        for (auto i : std::get<1>(p)) {
-            if (StackMap::isPatchpoint(i)) {
-                std::string name = ICCompiler::stubName(patchpoints.at(i));
-                patchIC((void*)CodeCache::getAddress(name), i, (void*)f);
-            }
-        }
+    // the stackmaps are in the global tables now
+    if (mm->stackmapAddr())
+        region->freeData(mm->stackmapAddr());
+
+    // point the IC slots to the initial icStubs
+    for (auto s : icSlots) {
+        region->addICSlot(s.first);
+        std::string name = ICCompiler::stubName(s.second);
+        patchIC((void*)CodeCache::getAddress(name), (uint64_t)s.first,
+                nullptr);
     }
 
     safepoints.clear();
-    patchpoints.clear();
+    icSlots.clear();
+
+    Profiler::finalize(m);
 
     return engine;
 }
@@ -142,7 +180,7 @@ void JITCompileLayer::recordStackmaps(ExecutionEngine* engine, Module* m,
     // Pass two: parse the current stackmap
     if (mm->stackmapAddr()) {
         ArrayRef<uint8_t> sm(mm->stackmapAddr(), mm->stackmapSize());
-        StackMap::recordStackmaps(sm, sp, patchpoints);
+        StackMap::recordStackmaps(sm, sp);
     }
 }
 
@@ -3,6 +3,7 @@
 
 #include "JITMemoryManager.h"
 #include "JITModule.h"
+#include "ICSlots.h"
 
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
@@ -24,10 +25,16 @@ class JITCompileLayer {
 
     static JITCompileLayer singleton;
 
-    ExecutionEngine* finalize(JITModule* m);
+    /** Compiles the module to native code. The code of hot modules (ICs,
+      optimized functions) is placed apart from baseline code.
+     */
+    ExecutionEngine* finalize(JITModule* m, bool hot = false);
     uint64_t getSafepointId(llvm::Function* f);
-    void setPatchpoint(uint64_t i, unsigned stubSize) {
-        patchpoints[i] = stubSize;
+    /** Registers the IC slot of a call site with stub for given number of
+      arguments. The slot is pointed to the stub when the module is finalized.
+     */
+    void addICSlot(ICSlots::Slot* slot, unsigned stubSize) {
+        icSlots.push_back(std::make_pair(slot, stubSize));
     }
 
   private:
@@ -36,7 +43,7 @@ class JITCompileLayer {
 
     uint64_t nextStackmapId = 2;
     FunctionToStackmap safepoints;
-    std::unordered_map<uint64_t, unsigned> patchpoints;
+    std::vector<std::pair<ICSlots::Slot*, unsigned>> icSlots;
 };
 }
 
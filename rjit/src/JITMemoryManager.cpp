@@ -2,6 +2,10 @@
 #include "JITSymbolResolver.h"
 #include <iostream>
 #include <unordered_map>
+#include <iterator>
+
+#include <sys/mman.h>
+#include <unistd.h>
 
 namespace rjit {
 
@@ -10,9 +14,7 @@ uint64_t JITMemoryManager::getSymbolAddress(const std::string& name) {
     return JITSymbolResolver::singleton.findSymbol(name).getAddress();
 }
 
-// This is mostly a 1:1 copy from DynldMemoryManager which additionally exports
-// stackmapAddr
-// TODO: maybe find a better allocation strategy, which keeps data together?
+// Same as the DynldMemoryManager, but additionally exports stackmapAddr
 uint8_t* JITMemoryManager::allocateDataSection(uintptr_t size,
                                                unsigned alignment,
                                                unsigned sectionID,
@@ -34,130 +36,215 @@ uint8_t* JITMemoryManager::allocateDataSection(uintptr_t size,
     return res;
 }
 
+void JITMemoryManager::takeMemory(std::vector<llvm::sys::MemoryBlock>& code,
+                                  std::vector<llvm::sys::MemoryBlock>& data) {
+    code.insert(code.end(), CodeMem.AllocatedMem.begin(),
+                CodeMem.AllocatedMem.end());
+    data.insert(data.end(), RODataMem.AllocatedMem.begin(),
+                RODataMem.AllocatedMem.end());
+    data.insert(data.end(), RWDataMem.AllocatedMem.begin(),
+                RWDataMem.AllocatedMem.end());
+    for (MemoryGroup* g : {&CodeMem, &RODataMem, &RWDataMem})
+        g->AllocatedMem.clear();
+}
+
 uint8_t* JITMemoryManager::allocateSection(MemoryGroup& MemGroup,
                                            uintptr_t Size, unsigned Alignment) {
+    uint8_t* addr = SlabAllocator::allocate(MemGroup.space, Size, Alignment);
+    if (addr)
+        MemGroup.AllocatedMem.push_back(sys::MemoryBlock(addr, Size));
+    return addr;
+}
 
-    if (!Alignment)
-        Alignment = 16;
-
-    assert(!(Alignment & (Alignment - 1)) &&
-           "Alignment must be a power of two.");
-
-    uintptr_t RequiredSize =
-        Alignment * ((Size + Alignment - 1) / Alignment + 1);
-    uintptr_t Addr = 0;
-
-    // Look in the list of free memory regions and use a block there if one
-    // is available.
-    for (int i = 0, e = MemGroup.FreeMem.size(); i != e; ++i) {
-        llvm::sys::MemoryBlock& MB = MemGroup.FreeMem[i];
-        if (MB.size() >= RequiredSize) {
-            Addr = (uintptr_t)MB.base();
-            uintptr_t EndOfBlock = Addr + MB.size();
-            // Align the address.
-            Addr = (Addr + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
-            // Store cutted free memory block.
-            MemGroup.FreeMem[i] = llvm::sys::MemoryBlock(
-                (void*)(Addr + Size), EndOfBlock - Addr - Size);
-            return (uint8_t*)Addr;
+bool JITMemoryManager::finalizeMemory(std::string* ErrMsg) {
+    // The relocations are resolved, nothing writes the code and the read-only
+    // data any more
+    for (MemoryGroup* g : {&CodeMem, &RODataMem}) {
+        if (!SlabAllocator::seal(g->space, g->AllocatedMem)) {
+            if (ErrMsg)
+                *ErrMsg = "Cannot change the permissions of jitted sections";
+            return true;
         }
     }
 
-    // No pre-allocated free block was large enough. Allocate a new memory
-    // region.
-    // Note that all sections get allocated as read-write.  The permissions will
-    // be updated later based on memory group.
-    //
-    // FIXME: It would be useful to define a default allocation size (or add
-    // it as a constructor parameter) to minimize the number of allocations.
-    //
-    // FIXME: Initialize the Near member for each memory group to avoid
-    // interleaving.
-    std::error_code ec;
-    llvm::sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(
-        RequiredSize, &MemGroup.Near,
-        sys::Memory::MF_READ | sys::Memory::MF_WRITE, ec);
-    if (ec) {
-        // FIXME: Add error propagation to the interface.
-        return nullptr;
-    }
+    // Some platforms with separate data cache and instruction cache require
+    // explicit cache flush, otherwise JIT code manipulations (like resolved
+    // relocations) will get to the data cache but not to the instruction
+    // cache.
+    for (auto& b : CodeMem.AllocatedMem)
+        sys::Memory::InvalidateInstructionCache(b.base(), b.size());
 
-    // Save this address as the basis for our next request
-    MemGroup.Near = MB;
+    return false;
+}
 
-    MemGroup.AllocatedMem.push_back(MB);
-    Addr = (uintptr_t)MB.base();
-    uintptr_t EndOfBlock = Addr + MB.size();
+SlabAllocator::Slabs SlabAllocator::hot;
+SlabAllocator::Slabs SlabAllocator::cold;
+SlabAllocator::Slabs SlabAllocator::rodata;
+SlabAllocator::Slabs SlabAllocator::data;
 
-    // Align the address.
-    Addr = (Addr + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+namespace {
+uintptr_t pageSize() {
+    static uintptr_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
 
-    // The allocateMappedMemory may allocate much more memory than we need. In
-    // this case, we store the unused memory as a free memory block.
-    unsigned FreeSize = EndOfBlock - Addr - Size;
-    if (FreeSize > 16)
-        MemGroup.FreeMem.push_back(
-            sys::MemoryBlock((void*)(Addr + Size), FreeSize));
+uintptr_t pageStart(uintptr_t addr) { return addr & ~(pageSize() - 1); }
 
-    // Return aligned address
-    return (uint8_t*)Addr;
+uintptr_t pageEnd(uintptr_t addr) { return pageStart(addr + pageSize() - 1); }
 }
 
-std::error_code
-JITMemoryManager::applyMemoryGroupPermissions(MemoryGroup& MemGroup,
-                                              unsigned Permissions) {
-
-    for (int i = 0, e = MemGroup.AllocatedMem.size(); i != e; ++i) {
-        std::error_code ec;
-        ec = sys::Memory::protectMappedMemory(MemGroup.AllocatedMem[i],
-                                              Permissions);
-        if (ec) {
-            return ec;
-        }
+SlabAllocator::Slabs& SlabAllocator::slabs(Space space) {
+    switch (space) {
+    case Space::HotCode:
+        return hot;
+    case Space::ColdCode:
+        return cold;
+    case Space::ROData:
+        return rodata;
+    case Space::Data:
+        return data;
     }
+    assert(false);
+    return data;
+}
 
-    return std::error_code();
+uint8_t* SlabAllocator::allocate(Space space, uintptr_t size,
+                                 unsigned alignment) {
+    return allocate(slabs(space), space, size, alignment);
 }
 
-bool JITMemoryManager::finalizeMemory(std::string* ErrMsg) {
-    // FIXME: Should in-progress permissions be reverted if an error occurs?
-    std::error_code ec;
-
-    // Don't allow free memory blocks to be used after setting protection flags.
-    CodeMem.FreeMem.clear();
-
-    // Make code memory executable.
-    ec = applyMemoryGroupPermissions(CodeMem, sys::Memory::MF_WRITE |
-                                                  sys::Memory::MF_READ |
-                                                  sys::Memory::MF_EXEC);
-    if (ec) {
-        if (ErrMsg) {
-            *ErrMsg = ec.message();
-        }
-        return true;
+uint8_t* SlabAllocator::allocate(Slabs& s, Space space, uintptr_t size,
+                                 unsigned alignment) {
+    if (!alignment)
+        alignment = 16;
+
+    assert(!(alignment & (alignment - 1)) &&
+           "Alignment must be a power of two.");
+
+    auto align = [alignment](uintptr_t addr) {
+        return (addr + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    };
+
+    // First fit from the freed sections. The pages of sealed spaces are
+    // shared with live sections, only whole free pages are made writable.
+    bool whole = sealed(space);
+    for (auto i = s.freeList.begin(); i != s.freeList.end(); ++i) {
+        uintptr_t start = i->first;
+        uintptr_t end = start + i->second;
+        uintptr_t addr = align(whole ? pageEnd(start) : start);
+        if ((whole ? pageEnd(addr + size) : addr + size) > end)
+            continue;
+        if (whole &&
+            mprotect((void*)pageStart(addr),
+                     pageEnd(addr + size) - pageStart(addr),
+                     PROT_READ | PROT_WRITE) != 0)
+            return nullptr;
+        s.freeList.erase(i);
+        if (addr > start)
+            s.freeList[start] = addr - start;
+        if (end > addr + size)
+            s.freeList[addr + size] = end - addr - size;
+        return (uint8_t*)addr;
     }
 
-    // Don't allow free memory blocks to be used after setting protection flags.
-    RODataMem.FreeMem.clear();
+    uintptr_t addr = align(s.next);
+    if (addr + size > s.end) {
+        // the rest of the current slab stays available
+        if (s.end > s.next)
+            free(sys::MemoryBlock((void*)s.next, s.end - s.next));
+        newSlab(s, space, size + alignment);
+        addr = align(s.next);
+        if (addr + size > s.end)
+            return nullptr;
+    }
+    // the padding is freed too, so that whole pages become free again
+    if (addr > s.next)
+        free(sys::MemoryBlock((void*)s.next, addr - s.next));
+    s.next = addr + size;
+    return (uint8_t*)addr;
+}
 
-    // Make read-only data memory read-only.
-    ec = applyMemoryGroupPermissions(RODataMem, sys::Memory::MF_READ |
-                                                    sys::Memory::MF_EXEC);
-    if (ec) {
-        if (ErrMsg) {
-            *ErrMsg = ec.message();
-        }
-        return true;
+void SlabAllocator::newSlab(Slabs& s, Space space, uintptr_t size) {
+    uintptr_t length = (size + hugePageSize - 1) & ~(hugePageSize - 1);
+    if (length < slabSize)
+        length = slabSize;
+
+    // Over-allocate to align the slab to huge pages, sealed spaces are
+    // protected once their modules are finalized
+    void* m = mmap(nullptr, length + hugePageSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+        s.next = s.end = 0;
+        return;
     }
+    uintptr_t map = (uintptr_t)m;
+    uintptr_t begin = (map + hugePageSize - 1) & ~(hugePageSize - 1);
+    if (begin > map)
+        munmap(m, begin - map);
+    if (map + hugePageSize > begin)
+        munmap((void*)(begin + length), map + hugePageSize - begin);
+
+#ifdef MADV_HUGEPAGE
+    if (space == Space::HotCode || space == Space::ColdCode)
+        madvise((void*)begin, length, MADV_HUGEPAGE);
+#endif
+
+    s.slabs[begin] = begin + length;
+    s.next = begin;
+    s.end = begin + length;
+}
 
-    // Read-write data memory already has the correct permissions
+bool SlabAllocator::seal(Space space, ArrayRef<sys::MemoryBlock> blocks) {
+    assert(sealed(space));
+    int prot = space == Space::ROData ? PROT_READ : PROT_READ | PROT_EXEC;
+    for (auto& b : blocks) {
+        uintptr_t start = pageStart((uintptr_t)b.base());
+        uintptr_t end = pageEnd((uintptr_t)b.base() + b.size());
+        if (mprotect((void*)start, end - start, prot) != 0)
+            return false;
+    }
 
-    // Some platforms with separate data cache and instruction cache require
-    // explicit cache flush, otherwise JIT code manipulations (like resolved
-    // relocations) will get to the data cache but not to the instruction cache.
-    invalidateInstructionCache();
+    // the rest of the last page was sealed as well
+    Slabs& s = slabs(space);
+    uintptr_t next = pageEnd(s.next);
+    if (next > s.next && next <= s.end) {
+        free(sys::MemoryBlock((void*)s.next, next - s.next));
+        s.next = next;
+    }
+    return true;
+}
 
-    return false;
+void SlabAllocator::free(sys::MemoryBlock block) {
+    uintptr_t start = (uintptr_t)block.base();
+    uintptr_t size = block.size();
+
+    for (Slabs* s : {&hot, &cold, &rodata, &data}) {
+        auto slab = s->slabs.upper_bound(start);
+        if (slab == s->slabs.begin())
+            continue;
+        --slab;
+        if (start >= slab->second)
+            continue;
+        assert(start + size <= slab->second);
+
+        // merge with the adjacent free blocks
+        auto& freeList = s->freeList;
+        auto next = freeList.lower_bound(start);
+        if (next != freeList.end() && start + size == next->first) {
+            size += next->second;
+            next = freeList.erase(next);
+        }
+        if (next != freeList.begin()) {
+            auto prev = std::prev(next);
+            if (prev->first + prev->second == start) {
+                prev->second += size;
+                return;
+            }
+        }
+        freeList[start] = size;
+        return;
+    }
+    assert(false && "Memory not allocated by the SlabAllocator");
 }
 
 } // namespace rjit
@@ -25,18 +25,92 @@
 
 using namespace llvm;
 
+#include <map>
+#include <vector>
+
 namespace rjit {
 
+/** Memory for the sections of all modules.
+
+  Large slabs are mapped up front and sections are bump allocated from them,
+  so that the code of many small modules and ICs shares pages instead of each
+  section getting its own mapping. Freed sections are kept in a free list and
+  reused first.
+
+  Code is placed either into the hot or into the cold space. ICs and
+  optimized functions go to the hot one, keeping the code executed most often
+  packed together. Code slabs use transparent huge pages where available.
+
+  Code and read-only data are written while the module is linked only. Their
+  slabs are mapped read-write, and seal gives the pages of a finalized module
+  their final permissions. The next module starts on a fresh page, and freed
+  memory of these spaces is only reused in whole pages, so that the
+  permissions of live sections never change.
+ */
+class SlabAllocator {
+  public:
+    enum class Space { HotCode, ColdCode, ROData, Data };
+
+    static uint8_t* allocate(Space space, uintptr_t size, unsigned alignment);
+
+    /** Makes the pages of blocks, all of them allocated from space by one
+      module, read-execute (code) or read-only (ROData). Returns false if
+      the permissions cannot be changed.
+     */
+    static bool seal(Space space,
+                     llvm::ArrayRef<llvm::sys::MemoryBlock> blocks);
+
+    static void free(llvm::sys::MemoryBlock block);
+
+  private:
+    struct Slabs {
+        /** Start and end of each slab.
+         */
+        std::map<uintptr_t, uintptr_t> slabs;
+        /** Unused memory: start to size, adjacent blocks are merged.
+         */
+        std::map<uintptr_t, uintptr_t> freeList;
+        uintptr_t next = 0;
+        uintptr_t end = 0;
+    };
+
+    static uint8_t* allocate(Slabs& s, Space space, uintptr_t size,
+                             unsigned alignment);
+
+    static void newSlab(Slabs& s, Space space, uintptr_t size);
+
+    static Slabs& slabs(Space space);
+
+    static bool sealed(Space space) { return space != Space::Data; }
+
+    /** Sections larger than this get a slab of their own.
+     */
+    static constexpr uintptr_t slabSize = 16 * 1024 * 1024;
+    static constexpr uintptr_t hugePageSize = 2 * 1024 * 1024;
+
+    static Slabs hot;
+    static Slabs cold;
+    static Slabs rodata;
+    static Slabs data;
+};
+
 class JITMemoryManager : public llvm::SectionMemoryManager {
   private:
     struct MemoryGroup {
+        MemoryGroup(SlabAllocator::Space space) : space(space) {}
+        SlabAllocator::Space space;
         llvm::SmallVector<llvm::sys::MemoryBlock, 16> AllocatedMem;
-        llvm::SmallVector<llvm::sys::MemoryBlock, 16> FreeMem;
-        llvm::sys::MemoryBlock Near;
     };
 
   public:
-    JITMemoryManager(){};
+    /** Hot modules (ICs, optimized functions) get their code placed apart
+      from baseline code.
+     */
+    JITMemoryManager(bool hot)
+        : CodeMem(hot ? SlabAllocator::Space::HotCode
+                      : SlabAllocator::Space::ColdCode),
+          RODataMem(SlabAllocator::Space::ROData),
+          RWDataMem(SlabAllocator::Space::Data){};
 
     uint64_t getSymbolAddress(const std::string& name) override;
 
@@ -54,19 +128,21 @@ class JITMemoryManager : public llvm::SectionMemoryManager {
     uint8_t* stackmapAddr() { return stackmapAddr_; }
     uintptr_t stackmapSize() { return stackmapSize_; }
 
+    /** Hands all memory allocated so far over to the caller (see CodeRegion),
+      which has to return it to the SlabAllocator.
+     */
+    void takeMemory(std::vector<llvm::sys::MemoryBlock>& code,
+                    std::vector<llvm::sys::MemoryBlock>& data);
+
   private:
     uint8_t* allocateSection(MemoryGroup& MemGroup, uintptr_t Size,
                              unsigned Alignment);
 
     bool finalizeMemory(std::string* ErrMsg) override;
-
-    std::error_code applyMemoryGroupPermissions(MemoryGroup& MemGroup,
-                                                unsigned Permissions);
     ~JITMemoryManager() {
-        // TODO: for now our memory manager leaks CodeMem, RODataMem and
-        // RWDataMem, since we currently never collect code memory.
-        // This allows us to safely delete the memory manager instance, without
-        // deleting all the code.
+        // The memory is not released here, since the code outlives the
+        // execution engine owning the memory manager. It is handed over to a
+        // CodeRegion instead, which frees it once the code is dead.
     }
 
     uint8_t* stackmapAddr_ = nullptr;
@@ -1,5 +1,7 @@
 #include "JITModule.h"
 #include "RIntlns.h"
+#include "CodeRegion.h"
+#include "Protect.h"
 
 using namespace llvm;
 
@@ -9,11 +11,17 @@ SEXP JITModule::formals(llvm::Function* f) {
 
 SEXP JITModule::constPool(llvm::Function* f) { return CDR(relocations.at(f)); }
 
+SEXP JITModule::nativeSXP(llvm::Function* f) {
+    auto i = relocations.find(f);
+    return i == relocations.end() ? nullptr : i->second;
+}
+
 SEXP JITModule::getNativeSXP(SEXP formals, SEXP ast,
                              std::vector<SEXP> const& objects, Function* f) {
 
     formals_[f] = formals;
-    SEXP objs = allocVector(VECSXP, objects.size());
+    // the last slot is reserved for the code region token
+    SEXP objs = allocVector(VECSXP, objects.size() + 1);
     for (size_t i = 0; i < objects.size(); ++i)
         SET_VECTOR_ELT(objs, i, objects[i]);
     SEXP result = CONS(nullptr, objs);
@@ -23,7 +31,14 @@ SEXP JITModule::getNativeSXP(SEXP formals, SEXP ast,
     return result;
 }
 
-void JITModule::finalizeNativeSEXPs(llvm::ExecutionEngine* engine) {
+void JITModule::finalizeNativeSEXPs(llvm::ExecutionEngine* engine,
+                                    rjit::CodeRegion* region) {
+    if (relocations.empty())
+        return;
+
+    rjit::Protect p;
+    SEXP token = p(region->token());
+
     // perform all the relocations
     for (auto r : relocations) {
         SEXP s = std::get<1>(r);
@@ -31,6 +46,8 @@ void JITModule::finalizeNativeSEXPs(llvm::ExecutionEngine* engine) {
         auto fp = engine->getPointerToFunction(f);
         assert(fp);
         SETCAR(s, reinterpret_cast<SEXP>(fp));
+        SEXP pool = CDR(s);
+        SET_VECTOR_ELT(pool, XLENGTH(pool) - 1, token);
     }
 }
 
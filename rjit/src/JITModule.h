@@ -7,6 +7,10 @@
 
 #include <unordered_map>
 
+namespace rjit {
+class CodeRegion;
+}
+
 class JITModule : public llvm::Module {
   public:
     JITModule(const std::string& name, llvm::LLVMContext& ctx)
@@ -17,7 +21,17 @@ class JITModule : public llvm::Module {
     SEXP getNativeSXP(SEXP formals, SEXP ast, std::vector<SEXP> const& objects,
                       llvm::Function* f);
 
-    void finalizeNativeSEXPs(llvm::ExecutionEngine* engine);
+    /** Patches the native code into all NATIVESXPs of the module and stores
+      the token of the module's code region in the last slot of their constant
+      pools.
+     */
+    void finalizeNativeSEXPs(llvm::ExecutionEngine* engine,
+                             rjit::CodeRegion* region);
+
+    /** Returns the NATIVESXP of f, or nullptr if f is not a closure or
+      promise of the module (e.g. an IC).
+     */
+    SEXP nativeSXP(llvm::Function* f);
 
     SEXP constPool(llvm::Function* f);
     SEXP formals(llvm::Function* f);
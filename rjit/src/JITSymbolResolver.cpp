@@ -5,6 +5,8 @@
 #include "llvm/Support/DynamicLibrary.h"
 #include "Runtime.h"
 #include "Instrumentation.h"
+#include "StackScan.h"
+#include "IntrinsicCounters.h"
 #include <iostream>
 
 using namespace llvm;
@@ -17,39 +19,43 @@ void* JITSymbolResolver::getSymbolAddress(const std::string& name) const {
     assert(false);
 }
 
-RuntimeDyld::SymbolInfo JITSymbolResolver::findSymbol(const std::string& name) {
-    // Unmangle mach-o symbols
-    int st = (name[0] == '_') ? 1 : 0;
-    auto unmangled = name.c_str() + st;
-
-    uint64_t res = 0;
-
+JITSymbolResolver::JITSymbolResolver() {
     // Add your global symbols that you want to use in jitted functions
-    do {
+#define add(sym) symbols[#sym] = (uint64_t)&sym
+    add(patchIC);
+    add(compileIC);
+    add(recordType);
+    add(recordTypeSlow);
+    add(checkType);
+    add(recompileFunction);
+    add(convertToLogicalNoNASlow);
+    add(pushFrameMarker);
+    add(popFrameMarker);
+    add(unwindFrameMarkers);
+    add(countIntrinsic);
+#undef add
+}
 
-#define check(sym)                                                             \
-    if (name.compare(st, sizeof(#sym) - 1, #sym) == 0) {                       \
-        res = (uint64_t)&sym;                                                  \
-        break;                                                                 \
-    }
-        check(patchIC);
-        check(compileIC);
-        check(recordType);
-        check(checkType);
-        check(recompileFunction);
+RuntimeDyld::SymbolInfo JITSymbolResolver::findSymbol(const std::string& name) {
+    // Unmangle mach-o symbols
+    StringRef unmangled(name);
+    if (unmangled.startswith("_"))
+        unmangled = unmangled.drop_front();
 
-    } while (false);
+    auto known = symbols.find(unmangled);
+    if (known != symbols.end())
+        return RuntimeDyld::SymbolInfo(known->second, JITSymbolFlags::Exported);
 
     // Look for jited functions with that name
-    if (!res)
-        res = CodeCache::getAddress(unmangled);
+    uint64_t res = CodeCache::getAddress(unmangled);
 
     // Look for symbols in the current process with that name
     if (!res)
-        res =
-            (uint64_t)sys::DynamicLibrary::SearchForAddressOfSymbol(unmangled);
+        res = (uint64_t)sys::DynamicLibrary::SearchForAddressOfSymbol(
+            unmangled.str());
 
     assert(res && "Could not resolve a symbol");
+    symbols[unmangled] = res;
     return RuntimeDyld::SymbolInfo(res, JITSymbolFlags::Exported);
 }
 
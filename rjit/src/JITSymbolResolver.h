@@ -2,19 +2,32 @@
 #define JIT_SYMBOL_RESOLVER
 
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
+#include "llvm/ADT/StringMap.h"
 
 namespace rjit {
 
+/** Resolves the external symbols of the jitted modules.
+
+  The runtime functions of rjit are registered when the resolver is created.
+  Other symbols (IC stubs from the CodeCache, intrinsics and R functions from
+  the process) are looked up once and remembered, so that resolving a symbol
+  which was seen before is a single hash lookup without allocation.
+ */
 class JITSymbolResolver : public llvm::RuntimeDyld::SymbolResolver {
   public:
     static JITSymbolResolver singleton;
 
+    JITSymbolResolver();
+
     void* getSymbolAddress(const std::string& name) const;
 
     llvm::RuntimeDyld::SymbolInfo findSymbol(const std::string& name) override;
 
     llvm::RuntimeDyld::SymbolInfo
     findSymbolInLogicalDylib(const std::string& name) override;
+
+  private:
+    llvm::StringMap<uint64_t> symbols;
 };
 }
 
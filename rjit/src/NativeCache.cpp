@@ -0,0 +1,35 @@
+#include "NativeCache.h"
+#include "RIntlns.h"
+
+namespace rjit {
+
+std::unordered_map<SEXP, NativeCache::Entry> NativeCache::cache;
+std::unordered_map<SEXP, SEXP> NativeCache::bodies;
+
+SEXP NativeCache::get(SEXP body, SEXP formals, std::function<SEXP()> compile) {
+    auto i = cache.find(body);
+    if (i != cache.end() and i->second.formals == formals)
+        return i->second.native;
+    SEXP native = PROTECT(compile());
+    // the last slot of the constant pool is the code region token
+    SEXP consts = CDR(native);
+    SEXP token = VECTOR_ELT(consts, XLENGTH(consts) - 1);
+    cache[body] = {formals, native, token};
+    bodies[token] = body;
+    R_MakeWeakRefC(token, list3(native, body, formals), &finalizeEntry,
+                   FALSE);
+    UNPROTECT(1);
+    return native;
+}
+
+void NativeCache::finalizeEntry(SEXP token) {
+    auto b = bodies.find(token);
+    if (b == bodies.end())
+        return;
+    // the body may have been cached with other formals since
+    auto i = cache.find(b->second);
+    if (i != cache.end() and i->second.token == token)
+        cache.erase(i);
+    bodies.erase(b);
+}
+}
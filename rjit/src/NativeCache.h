@@ -0,0 +1,56 @@
+#ifndef NATIVE_CACHE_H
+#define NATIVE_CACHE_H
+
+#include <unordered_map>
+#include <functional>
+
+#include "RDefs.h"
+
+namespace rjit {
+
+/** Shares native code between closures created from the same function
+  definition.
+
+  Closures created by the R interpreter from one `function` expression (e.g.
+  in lapply(xs, function(x) ...)) all share the same body and formals, but
+  compileIC and recompileFunction update only the closure being called.
+  Without the cache every such closure compiles its body again.
+
+  The cache maps a body (ast, bytecode or baseline native code) to its compiled
+  NATIVESXP. Entries are held weakly: each one has a weak reference keyed on
+  the code region token of its NATIVESXP, whose value keeps the body, formals
+  and native code alive. Once no closure or frame uses the native code any
+  more, the finalizer of the reference drops the entry, so the code can be
+  freed. Until then the body's address cannot be reused by an unrelated
+  object.
+ */
+class NativeCache {
+  public:
+    /** Returns the native code for given body and formals, calling compile
+      and remembering its result if there is none yet.
+     */
+    static SEXP get(SEXP body, SEXP formals, std::function<SEXP()> compile);
+
+    static bool contains(SEXP body, SEXP formals) {
+        auto i = cache.find(body);
+        return i != cache.end() and i->second.formals == formals;
+    }
+
+  private:
+    struct Entry {
+        SEXP formals;
+        SEXP native;
+        SEXP token;
+    };
+
+    static void finalizeEntry(SEXP token);
+
+    static std::unordered_map<SEXP, Entry> cache;
+
+    /** Body of the entry by the code region token of its native code.
+     */
+    static std::unordered_map<SEXP, SEXP> bodies;
+};
+}
+
+#endif
@@ -89,7 +89,7 @@
 #include "GCPassApi.h"
 #include "JITGCStrategy.h"
 #include "JITCompileLayer.h"
-#include "Runtime.h"
+#include "ICSlots.h"
 
 #define DEBUG_TYPE "safepoint-placement"
 STATISTIC(NumCallSafepoints, "Number of call safepoints inserted");
@@ -394,22 +394,33 @@ static Value* ReplaceWithStatepoint(const CallSite& CS, /* to replace */
     if (isStatepoint)
         AttrsToRemove.addAttribute("needs-statepoint");
 
+    Value* StatepointTarget = CS.getCalledValue();
+
     if (isIcStubCall) {
         assert(stubSize != (uint64_t)-1);
 
-        // Register this stackmap id to be a patchpoint, such that later phases
-        // (i.e. the compile layer) can patch in initial stub calls.
-        rjit::JITCompileLayer::singleton.setPatchpoint(ID, stubSize);
+        // Every call site calls through its own IC slot. The compile layer
+        // points it to the initial stub once the module is finalized.
+        auto slot = rjit::ICSlots::allocate();
+        rjit::JITCompileLayer::singleton.addICSlot(slot, stubSize);
 
         CallInst* i = cast<CallInst>(CS.getInstruction());
         assert(i);
 
-        // The patchpoints (i.e. call stubs) expect the last argument to
-        // be the stackmap id.
-        i->setArgOperand(
-            i->getNumArgOperands() - 1,
-            ConstantInt::get(CS->getParent()->getParent()->getContext(),
-                             APInt(64, ID)));
+        LLVMContext& C = CS->getParent()->getParent()->getContext();
+
+        // The call stubs expect the last argument to be the slot, so that
+        // they can retarget it.
+        i->setArgOperand(i->getNumArgOperands() - 1,
+                         ConstantInt::get(C, APInt(64, (uint64_t)slot)));
+
+        auto targetT = cast<PointerType>(CS.getCalledValue()->getType());
+        Value* slotAddr = ConstantExpr::getIntToPtr(
+            ConstantInt::get(C, APInt(64, (uint64_t)slot)),
+            PointerType::get(targetT, 0));
+        LoadInst* target = Builder.CreateAlignedLoad(slotAddr, 8, "ic");
+        target->setAtomic(Unordered);
+        StatepointTarget = target;
 
         AttrsToRemove.addAttribute("ic-stub");
     }
@@ -418,14 +429,9 @@ static Value* ReplaceWithStatepoint(const CallSite& CS, /* to replace */
         CS.getInstruction()->getContext(), AttributeSet::FunctionIndex,
         AttrsToRemove);
 
-    Value* StatepointTarget =
-        isIcStubCall ? ConstantPointerNull::get(
-                           cast<PointerType>(CS.getCalledValue()->getType()))
-                     : CS.getCalledValue();
-
     CallInst* ToReplace = cast<CallInst>(CS.getInstruction());
     CallInst* Call = Builder.CreateGCStatepointCall(
-        ID, isIcStubCall ? rjit::patchpointSize : 0, StatepointTarget,
+        ID, 0, StatepointTarget,
         makeArrayRef(CS.arg_begin(), CS.arg_end()), None, None,
         "safepoint_token");
     Call->setTailCall(ToReplace->isTailCall());
@@ -0,0 +1,176 @@
+#include "Profiler.h"
+#include "Flags.h"
+#include "JITModule.h"
+#include "Protect.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+
+namespace rjit {
+
+std::list<Profiler::Entry> Profiler::entries;
+std::unordered_map<llvm::Function*, Profiler::Entry> Profiler::compiling;
+std::unordered_map<llvm::Module*, std::map<std::string, double>>
+    Profiler::modules;
+std::map<uintptr_t, std::list<Profiler::Entry>::iterator>
+    Profiler::byAddress;
+std::vector<Profiler::Running> Profiler::running;
+std::vector<std::string> Profiler::phaseOrder;
+
+bool Profiler::enabled() { return Flag::singleton().profile; }
+
+Profiler::Timer::Timer(llvm::Function* f, std::string const& phase) {
+    if (!enabled() || f == nullptr)
+        return;
+    Entry& e = compiling[f];
+    if (e.name.empty()) {
+        e.name = f->getName().str();
+        e.module = f->getParent()->getModuleIdentifier();
+    }
+    start(&e.phases, phase);
+}
+
+Profiler::Timer::Timer(llvm::Module* m, std::string const& phase) {
+    if (!enabled())
+        return;
+    start(&modules[m], phase);
+}
+
+void Profiler::Timer::start(std::map<std::string, double>* phases,
+                            std::string const& phase) {
+    if (std::find(phaseOrder.begin(), phaseOrder.end(), phase) ==
+        phaseOrder.end())
+        phaseOrder.push_back(phase);
+
+    auto now = Clock::now();
+    if (!running.empty()) {
+        Running& r = running.back();
+        (*r.phases)[r.phase] +=
+            std::chrono::duration<double>(now - r.start).count();
+    }
+    running.push_back({phases, phase, now});
+    active = true;
+}
+
+Profiler::Timer::~Timer() {
+    if (active)
+        stop();
+}
+
+void Profiler::stop() {
+    auto now = Clock::now();
+    Running& r = running.back();
+    (*r.phases)[r.phase] +=
+        std::chrono::duration<double>(now - r.start).count();
+    running.pop_back();
+    // resume the enclosing timer
+    if (!running.empty())
+        running.back().start = now;
+}
+
+void Profiler::countsInvocations(llvm::Function* f) {
+    auto i = compiling.find(f);
+    if (i != compiling.end())
+        i->second.counted = true;
+}
+
+void Profiler::finalize(JITModule* m) {
+    auto module = modules.find(m);
+    for (llvm::Function& f : m->getFunctionList()) {
+        auto i = compiling.find(&f);
+        if (i == compiling.end())
+            continue;
+
+        // ICs have no NATIVESXP, their passes are not reported
+        SEXP native = m->nativeSXP(&f);
+        if (native) {
+            entries.push_back(std::move(i->second));
+            Entry& e = entries.back();
+            if (module != modules.end())
+                for (auto& p : module->second)
+                    e.phases[p.first] += p.second;
+            if (e.counted)
+                e.invocations = VECTOR_ELT(CDR(native), 3);
+            byAddress[(uintptr_t)CAR(native)] = std::prev(entries.end());
+        }
+        compiling.erase(i);
+    }
+    if (module != modules.end())
+        modules.erase(module);
+}
+
+void Profiler::icMiss(void* caller) {
+    auto i = byAddress.find((uintptr_t)caller);
+    if (i != byAddress.end())
+        ++i->second->icMisses;
+}
+
+void Profiler::unregister(uintptr_t begin, uintptr_t end) {
+    auto i = byAddress.lower_bound(begin);
+    while (i != byAddress.end() && i->first < end) {
+        entries.erase(i->second);
+        i = byAddress.erase(i);
+    }
+}
+
+SEXP Profiler::report() {
+    int n = entries.size();
+    int columns = phaseOrder.size() + 4;
+
+    Protect p;
+    SEXP result = p(allocVector(VECSXP, columns));
+    SEXP names = p(allocVector(STRSXP, columns));
+
+    SEXP name = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 0, name);
+    SET_STRING_ELT(names, 0, mkChar("name"));
+    SEXP module = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 1, module);
+    SET_STRING_ELT(names, 1, mkChar("module"));
+    std::vector<Entry const*> rows;
+    for (auto& e : entries)
+        rows.push_back(&e);
+    for (int i = 0; i < n; ++i) {
+        SET_STRING_ELT(name, i, mkChar(rows[i]->name.c_str()));
+        SET_STRING_ELT(module, i, mkChar(rows[i]->module.c_str()));
+    }
+
+    int c = 2;
+    for (auto& phase : phaseOrder) {
+        SEXP time = allocVector(REALSXP, n);
+        SET_VECTOR_ELT(result, c, time);
+        SET_STRING_ELT(names, c++, mkChar(phase.c_str()));
+        for (int i = 0; i < n; ++i) {
+            auto t = rows[i]->phases.find(phase);
+            REAL(time)[i] = t == rows[i]->phases.end() ? 0 : t->second;
+        }
+    }
+
+    SEXP invocations = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, c, invocations);
+    SET_STRING_ELT(names, c++, mkChar("invocations"));
+    SEXP icMisses = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, c, icMisses);
+    SET_STRING_ELT(names, c++, mkChar("icMisses"));
+    for (int i = 0; i < n; ++i) {
+        SEXP count = rows[i]->invocations;
+        INTEGER(invocations)[i] = count ? INTEGER(count)[0] : NA_INTEGER;
+        INTEGER(icMisses)[i] = rows[i]->icMisses;
+    }
+
+    setAttrib(result, R_NamesSymbol, names);
+    SEXP rowNames = p(allocVector(INTSXP, 2));
+    INTEGER(rowNames)[0] = NA_INTEGER;
+    INTEGER(rowNames)[1] = -n;
+    setAttrib(result, R_RowNamesSymbol, rowNames);
+    setAttrib(result, R_ClassSymbol, mkString("data.frame"));
+    return result;
+}
+
+void Profiler::gcCallback(void (*forward_node)(SEXP)) {
+    for (auto& e : entries)
+        if (e.invocations)
+            forward_node(e.invocations);
+}
+}
@@ -0,0 +1,124 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RDefs.h"
+
+namespace llvm {
+class Function;
+class Module;
+}
+
+class JITModule;
+
+namespace rjit {
+
+/** Compile time and runtime profile of jitted functions.
+
+  Enabled by the profile flag. For every NATIVESXP the time spent building its
+  IR and in each rjit pass is recorded, together with the times of the module
+  wide phases (the remaining llvm optimizations, codegen and stackmap
+  registration) of the module it was compiled into. At runtime invocations
+  and IC misses of its call sites are counted.
+
+  The profile only keeps the invocation counters of the NATIVESXPs alive, so
+  that profiling does not prevent their code from being freed. The profiles
+  of freed code are dropped.
+ */
+class Profiler {
+  public:
+    static bool enabled();
+
+    /** Attributes the time until its destruction to a phase of a function or
+      a module. Timers started meanwhile pause it, so that nested compilation
+      is not counted twice.
+     */
+    class Timer {
+      public:
+        Timer(llvm::Function* f, std::string const& phase);
+        Timer(llvm::Module* m, std::string const& phase);
+        ~Timer();
+
+      private:
+        void start(std::map<std::string, double>* phases,
+                   std::string const& phase);
+
+        bool active = false;
+    };
+
+    /** Marks that the code of f increments the invocation counter in its
+      constant pool.
+     */
+    static void countsInvocations(llvm::Function* f);
+
+    /** Binds the profiles of the functions of a finalized module to their
+      NATIVESXPs.
+     */
+    static void finalize(JITModule* m);
+
+    /** Counts an IC miss in the native code at given address.
+     */
+    static void icMiss(void* caller);
+
+    /** Drops the profiles of the functions whose code lies in the given
+      range, called when the code is freed.
+     */
+    static void unregister(uintptr_t begin, uintptr_t end);
+
+    /** Returns the profile as a data frame with one row per NATIVESXP.
+     */
+    static SEXP report();
+
+    static void gcCallback(void (*forward_node)(SEXP));
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        std::string name;
+        std::string module;
+        std::map<std::string, double> phases;
+        bool counted = false;
+        SEXP invocations = nullptr;
+        int icMisses = 0;
+    };
+
+    struct Running {
+        std::map<std::string, double>* phases;
+        std::string phase;
+        Clock::time_point start;
+    };
+
+    static void stop();
+
+    /** Profiles of finalized NATIVESXPs, in the order they were compiled.
+     */
+    static std::list<Entry> entries;
+
+    /** Profiles of functions whose module was not finalized yet.
+     */
+    static std::unordered_map<llvm::Function*, Entry> compiling;
+    static std::unordered_map<llvm::Module*, std::map<std::string, double>>
+        modules;
+
+    /** Profiles of finalized NATIVESXPs by the address of their code.
+     */
+    static std::map<uintptr_t, std::list<Entry>::iterator> byAddress;
+
+    /** Running timers, only the last one is counting.
+     */
+    static std::vector<Running> running;
+
+    /** Phases in the order they were first seen.
+     */
+    static std::vector<std::string> phaseOrder;
+};
+}
+
+#endif
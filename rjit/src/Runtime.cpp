@@ -1,39 +1,33 @@
 #include "Runtime.h"
 #include "ICCompiler.h"
-#include "StackMap.h"
 #include "RIntlns.h"
 #include "Compiler.h"
 #include "api.h"
 #include "ir/Builder.h"
 #include "Instrumentation.h"
+#include "NativeCache.h"
+#include "CodeRegion.h"
+#include "ICSlots.h"
+#include "Profiler.h"
+#include "CompilePolicy.h"
 
-using namespace rjit;
-
-extern "C" void patchIC(void* ic, uint64_t stackmapId, void* caller) {
-    uint8_t* patchAddr = (uint8_t*)StackMap::getPatchpoint(stackmapId);
-
-    // reg 0 = rax
-    int reg = 0;
-    uint8_t prefix = reg > 7 ? 0x49 : 0x48;
-    uint8_t movinst = 0xb8 + (reg % 8);
+#include <chrono>
 
-    static_assert(patchpointSize == 12, "require 10 bytes to patch call");
+using namespace rjit;
 
-    // mov to rax
-    *patchAddr++ = prefix;
-    *patchAddr++ = movinst;
+extern "C" void patchIC(void* ic, uint64_t icSlot, void* caller) {
+    auto slot = reinterpret_cast<ICSlots::Slot*>(icSlot);
+    slot->store(ic, std::memory_order_release);
 
-    // absolute addr
-    *(void**)(patchAddr) = ic;
-    patchAddr += sizeof(void*);
+    // the previous ic of the call site can be freed
+    CodeRegion::patched(slot, ic);
 
-    // call rax
-    *patchAddr++ = 0xff;
-    *patchAddr++ = 0xd0;
+    if (caller)
+        Profiler::icMiss(caller);
 }
 
 extern "C" void* compileIC(uint64_t numargs, SEXP call, SEXP fun, SEXP rho,
-                           uint64_t stackmapId) {
+                           uint64_t icSlot) {
     SEXP body = CDR(fun);
     SEXP formals = CAR(fun);
 
@@ -51,18 +45,34 @@ extern "C" void* compileIC(uint64_t numargs, SEXP call, SEXP fun, SEXP rho,
     // recompiles already compiled bytecode expressions (used for testing
     // purposes), level 4 compiles ast expressions, level 5 compiles ast &
     // bytecode expressions.
-    bool compile =
-        (RJIT_COMPILE > 0 &&
-         (TYPEOF(body) == LANGSXP || TYPEOF(body) == BCODESXP)) ||
+    bool requested = RJIT_COMPILE > 0 &&
+                     (TYPEOF(body) == LANGSXP || TYPEOF(body) == BCODESXP);
+    bool automatic =
         (TYPEOF(body) == LANGSXP && R_ENABLE_JIT > 3) ||
         (TYPEOF(body) == BCODESXP && (R_ENABLE_JIT == 3 || R_ENABLE_JIT > 4));
 
+    // Explicit requests compile every closure. Otherwise code shared with
+    // other closures is free, other bodies are subject to the compile policy.
+    bool deferred = !requested && automatic &&
+                    !NativeCache::contains(body, formals) &&
+                    !CompilePolicy::compileNow(body);
+    bool compile = (requested || automatic) && !deferred;
+
     if (compile) {
-        Compiler c("module");
-        SEXP result = c.compile(name, body, formals);
-        c.finalize();
-        if (RJIT_DEBUG)
-            std::cout << "Compiled " << name << " @ " << (void*)result << "\n";
+        // closures of the same function definition share the code
+        SEXP result = NativeCache::get(body, formals, [&]() {
+            auto start = std::chrono::steady_clock::now();
+            Compiler c("module");
+            SEXP result = c.compile(name, body, formals);
+            c.finalize();
+            CompilePolicy::compiled(
+                body, std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start).count());
+            if (RJIT_DEBUG)
+                std::cout << "Compiled " << name << " @ " << (void*)result
+                          << "\n";
+            return result;
+        });
         SETCDR(fun, result);
     } else {
         if (RJIT_DEBUG)
@@ -77,7 +87,7 @@ extern "C" void* compileIC(uint64_t numargs, SEXP call, SEXP fun, SEXP rho,
 
     name.append("IC");
     ICCompiler compiler(numargs, b, name);
-    void* res = compiler.compile(call, fun, rho);
+    void* res = compiler.compile(call, fun, rho, deferred);
 
     return res;
 }
@@ -96,13 +106,14 @@ extern "C" void* recompileFunction(SEXP closure,
 
     SEXP body = BODY(closure);
 
-    SEXP result;
-    {
+    // other closures sharing the baseline code reuse the optimized version
+    SEXP result = NativeCache::get(body, FORMALS(closure), [&]() {
         Compiler c("optimized module");
-        result =
+        SEXP result =
             c.compileFunction("rOptFunction", body, FORMALS(closure), true);
-        c.finalize();
-    }
+        c.finalize(/*hot=*/true);
+        return result;
+    });
 
     SEXP(*newCaller)(SEXP, SEXP, SEXP) = (SEXP(*)(SEXP, SEXP, SEXP))CAR(result);
     SEXP newConsts = CDR(result);
@@ -110,3 +121,9 @@ extern "C" void* recompileFunction(SEXP closure,
 
     return newCaller(newConsts, rho, closure);
 }
+
+extern "C" int convertToLogicalNoNA(SEXP what, SEXP consts, int callIdx);
+
+extern "C" int convertToLogicalNoNASlow(SEXP what, SEXP consts, int callIdx) {
+    return convertToLogicalNoNA(what, consts, callIdx);
+}
@@ -5,19 +5,19 @@
 
 #include "RDefs.h"
 
-namespace rjit {
-
-const uint64_t patchpointSize = 12;
-
-} // namespace rjit
-
-extern "C" void patchIC(void* ic, uint64_t stackmapId, void* caller);
+/** Points the IC slot (an ICSlots::Slot*) of a call site to ic.
+ */
+extern "C" void patchIC(void* ic, uint64_t icSlot, void* caller);
 
 extern "C" void* compileIC(uint64_t numargs, SEXP call, SEXP fun, SEXP rho,
-                           uint64_t stackmapId);
+                           uint64_t icSlot);
 
 extern "C" void* recompileFunction(SEXP closure,
                                    SEXP (*caller)(SEXP, SEXP, SEXP),
                                    SEXP consts, SEXP rho);
 
+/** Slow path of the convertToLogicalNoNA fast path (fastpaths/intrinsics.c).
+ */
+extern "C" int convertToLogicalNoNASlow(SEXP what, SEXP consts, int callIdx);
+
 #endif // RUNTIME_H_
@@ -0,0 +1,159 @@
+#include "Sampler.h"
+#include "CodeSymbols.h"
+#include "StackScan.h"
+#include "Protect.h"
+
+#include "RIntlns.h"
+
+#include <algorithm>
+#include <sys/time.h>
+#include <ucontext.h>
+
+namespace rjit {
+
+Sampler::Sample* Sampler::samples = nullptr;
+std::atomic<unsigned> Sampler::taken(0);
+std::atomic<unsigned> Sampler::dropped(0);
+unsigned Sampler::native = 0;
+bool Sampler::running = false;
+pthread_t Sampler::thread;
+struct sigaction Sampler::previous;
+
+void Sampler::start(unsigned interval) {
+    if (running)
+        return;
+    if (!samples)
+        samples = new Sample[capacity];
+    thread = pthread_self();
+
+    struct sigaction action;
+    action.sa_sigaction = &handler;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previous);
+
+    struct itimerval timer;
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    running = true;
+}
+
+void Sampler::stop() {
+    if (!running)
+        return;
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previous, nullptr);
+    running = false;
+    aggregate();
+}
+
+void Sampler::handler(int, siginfo_t*, void* context) {
+    if (!pthread_equal(pthread_self(), thread))
+        return;
+    unsigned i = taken.fetch_add(1, std::memory_order_relaxed);
+    if (i >= capacity) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    Sample& s = samples[i];
+    s.depth = 0;
+#if defined(__linux__) && defined(__x86_64__)
+    auto uc = static_cast<ucontext_t*>(context);
+    s.pcs[s.depth++] = uc->uc_mcontext.gregs[REG_RIP];
+#endif
+    s.depth += StackScan::returnAddresses(s.pcs + s.depth, maxDepth - s.depth);
+}
+
+void Sampler::aggregate() {
+    if (!samples)
+        return;
+
+    // the handler must not add samples while the buffer is drained
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+
+    std::vector<CodeSymbols::Symbol*> seen;
+    unsigned n = taken.load(std::memory_order_relaxed);
+    // samples past the capacity were counted as dropped
+    if (n > capacity)
+        n = capacity;
+    for (unsigned i = 0; i < n; ++i) {
+        Sample& s = samples[i];
+        seen.clear();
+        for (unsigned d = 0; d < s.depth; ++d) {
+            // a return address can be right past the end of the caller
+            uintptr_t pc = d == 0 ? s.pcs[d] : s.pcs[d] - 1;
+            CodeSymbols::Symbol* sym = CodeSymbols::find(pc);
+            if (!sym || std::find(seen.begin(), seen.end(), sym) != seen.end())
+                continue;
+            if (seen.empty())
+                ++sym->self;
+            ++sym->total;
+            seen.push_back(sym);
+        }
+        if (seen.empty())
+            ++native;
+    }
+    taken.store(0, std::memory_order_relaxed);
+
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+SEXP Sampler::report() {
+    aggregate();
+
+    std::vector<CodeSymbols::Symbol const*> rows;
+    CodeSymbols::forEach([&rows](CodeSymbols::Symbol const& s) {
+        if (s.total)
+            rows.push_back(&s);
+    });
+    std::sort(rows.begin(), rows.end(),
+              [](CodeSymbols::Symbol const* a, CodeSymbols::Symbol const* b) {
+                  return a->self > b->self;
+              });
+    int n = rows.size() + 1;
+
+    Protect p;
+    SEXP result = p(allocVector(VECSXP, 4));
+    SEXP name = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 0, name);
+    SEXP location = allocVector(STRSXP, n);
+    SET_VECTOR_ELT(result, 1, location);
+    SEXP self = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, 2, self);
+    SEXP total = allocVector(INTSXP, n);
+    SET_VECTOR_ELT(result, 3, total);
+
+    for (int i = 0; i < n - 1; ++i) {
+        SET_STRING_ELT(name, i, mkChar(rows[i]->name.c_str()));
+        SET_STRING_ELT(location, i, rows[i]->location.empty()
+                                        ? NA_STRING
+                                        : mkChar(rows[i]->location.c_str()));
+        INTEGER(self)[i] = rows[i]->self;
+        INTEGER(total)[i] = rows[i]->total;
+    }
+    SET_STRING_ELT(name, n - 1, mkChar("<native>"));
+    SET_STRING_ELT(location, n - 1, NA_STRING);
+    INTEGER(self)[n - 1] = native;
+    INTEGER(total)[n - 1] = native;
+
+    SEXP names = p(allocVector(STRSXP, 4));
+    SET_STRING_ELT(names, 0, mkChar("name"));
+    SET_STRING_ELT(names, 1, mkChar("location"));
+    SET_STRING_ELT(names, 2, mkChar("self"));
+    SET_STRING_ELT(names, 3, mkChar("total"));
+    setAttrib(result, R_NamesSymbol, names);
+    SEXP rowNames = p(allocVector(INTSXP, 2));
+    INTEGER(rowNames)[0] = NA_INTEGER;
+    INTEGER(rowNames)[1] = -n;
+    setAttrib(result, R_RowNamesSymbol, rowNames);
+    setAttrib(result, R_ClassSymbol, mkString("data.frame"));
+    setAttrib(result, install("dropped"), ScalarInteger(dropped.load()));
+    return result;
+}
+}
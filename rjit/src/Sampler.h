@@ -0,0 +1,70 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <pthread.h>
+
+#include "RDefs.h"
+
+namespace rjit {
+
+/** Sampling profiler of the jitted code.
+
+  A SIGPROF timer interrupts the process at a fixed interval of cpu time. The
+  handler records the interrupted pc and the return addresses of the stack
+  (see StackScan) into a preallocated buffer. The samples are attributed to
+  the jitted functions (see CodeSymbols) later, outside of the handler: when
+  the report is requested, at every gc and before code is freed.
+
+  The timer signal may be delivered to any thread of the process, only the
+  thread which started the sampler is sampled.
+
+  The sampler uses the same signal as Rprof, so both cannot be used at the
+  same time.
+ */
+class Sampler {
+  public:
+    /** Starts sampling every interval microseconds of cpu time.
+     */
+    static void start(unsigned interval);
+
+    static void stop();
+
+    /** Attributes the buffered samples to the jitted functions.
+     */
+    static void aggregate();
+
+    /** Returns a data frame with the number of samples per jitted function,
+      the ones not in jitted code are reported as "<native>".
+     */
+    static SEXP report();
+
+  private:
+    static constexpr unsigned maxDepth = 32;
+    static constexpr unsigned capacity = 4096;
+
+    struct Sample {
+        unsigned depth;
+        uintptr_t pcs[maxDepth];
+    };
+
+    static void handler(int signal, siginfo_t* info, void* context);
+
+    static Sample* samples;
+    static std::atomic<unsigned> taken;
+    /** Samples lost because the buffer was full.
+     */
+    static std::atomic<unsigned> dropped;
+    /** Samples without a jitted frame.
+     */
+    static unsigned native;
+
+    static bool running;
+    static pthread_t thread;
+    static struct sigaction previous;
+};
+}
+
+#endif
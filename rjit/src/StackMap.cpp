@@ -1,85 +1,148 @@
 #include "StackMap.h"
 
-#include "Runtime.h"
-
 #include "llvm/IR/Instructions.h"
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Attributes.h>
 
-using namespace llvm;
-
-namespace rjit {
-
-// Statepoints are identified by their pc address as seen on the runtime
-// stack while scanning for roots.
-void StackMap::registerStatepoint(uintptr_t function, uintptr_t offset,
-                                  stackmap_t stackmap,
-                                  unsigned stackmapOffset) {
-    statepoint.emplace(function + offset,
-                       StatepointRecord({stackmap, stackmapOffset, function}));
-}
-
-// Patchpoints are identified by their unique id given at compile time
-void StackMap::registerPatchpoint(uint64_t id, uintptr_t pos) {
-    patchpoint.emplace(id, pos);
-}
+#include <llvm/ADT/Hashing.h>
 
-bool StackMap::isStatepoint(uintptr_t pc) { return statepoint.count(pc); }
+#include <algorithm>
 
-StackMapParserT::RecordAccessor StackMap::getStatepoint(uintptr_t pc) {
-    assert(statepoint.count(pc));
-
-    StatepointRecord& e = statepoint.at(pc);
-    StackMapParserT p(e.stackmap);
-    const auto& r = p.getRecord(e.idx);
-    return r;
-}
+using namespace llvm;
 
-unsigned StackMap::getStackSize(uintptr_t pc) {
-    StatepointRecord& e = statepoint.at(pc);
-    StackMapParserT p(e.stackmap);
-    for (auto& f : p.functions()) {
-        if (f.getFunctionAddress() == e.fun)
-            return f.getStackSize();
-    }
-    assert(false);
-    return 0;
-}
+namespace rjit {
 
-uintptr_t StackMap::getPatchpoint(uint64_t id) {
-    assert(patchpoint.count(id));
-    return patchpoint.at(id);
+StackMap::StatepointRecord const* StackMap::findStatepoint(uintptr_t pc) {
+    StatepointRecord key = {pc, 0, 0};
+    auto i = std::lower_bound(statepoints.begin(), statepoints.end(), key);
+    if (i == statepoints.end() or i->pc != pc)
+        return nullptr;
+    return &*i;
 }
 
 // record stackmaps will parse the stackmap section of the current module and
 // index all entries.
-void StackMap::recordStackmaps(
-    stackmap_t sm, const StackmapToFunction& safepoints,
-    const std::unordered_map<uint64_t, unsigned>& patchpoints) {
+void StackMap::recordStackmaps(stackmap_t sm,
+                               const StackmapToFunction& safepoints) {
     StackMapParserT p(sm);
 
-    int i = 0;
+    size_t firstNew = statepoints.size();
     for (const auto& r : p.records()) {
         assert(r.getID() != (uint64_t)-1 &&
                r.getID() != StackMap::genericStatepointID);
 
         assert(safepoints.count(r.getID()));
-        bool isPatchpoint = patchpoints.count(r.getID());
 
         auto function = safepoints.at(r.getID());
+        uintptr_t pc = function + r.getInstructionOffset();
+
+        std::vector<int32_t> offsets;
+        for (const auto& Loc : r.locations()) {
+            if (Loc.getKind() == StackMapParserT::LocationKind::Direct) {
+                // Statepoint args should be spilled =>
+                // reg is == 7 (rsp)
+                assert(Loc.getDwarfRegNum() == 7);
+                offsets.push_back(Loc.getOffset());
+            }
+        }
+        StatepointRecord record = {pc, 0, 0};
+        record.spillSet = addSpillSet(offsets);
+        record.numSpills = offsets.size();
+        statepoints.push_back(record);
+    }
+
+    // keep the records sorted by pc, new ones are merged in
+    std::sort(statepoints.begin() + firstNew, statepoints.end());
+    std::inplace_merge(statepoints.begin(), statepoints.begin() + firstNew,
+                       statepoints.end());
+}
+
+uint32_t StackMap::addSpillSet(std::vector<int32_t>& offsets) {
+    if (offsets.empty())
+        return 0;
+
+    // a slot holding several of the gc pointers is only scanned once
+    std::sort(offsets.begin(), offsets.end());
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    std::vector<uint8_t> key;
+    int32_t last = 0;
+    for (auto o : offsets) {
+        encode(o - last, key);
+        last = o;
+    }
 
-        StackMap::registerStatepoint(function, r.getInstructionOffset(), sm, i);
-        if (isPatchpoint) {
-            StackMap::registerPatchpoint(r.getID(),
-                                         function + r.getInstructionOffset() -
-                                             patchpointSize);
+    size_t h = hash(key.data(), key.data() + key.size());
+    auto range = spillSetIndex.equal_range(h);
+    for (auto i = range.first; i != range.second; ++i) {
+        SpillSet& set = i->second;
+        if (set.length == key.size() &&
+            std::equal(key.begin(), key.end(), spillSets.begin() + set.start)) {
+            ++set.uses;
+            return set.start;
         }
+    }
+    uint32_t start = spillSets.size();
+    spillSets.insert(spillSets.end(), key.begin(), key.end());
+    spillSetIndex.insert({h, {start, (uint32_t)key.size(), 1}});
+    return start;
+}
+
+size_t StackMap::hash(uint8_t const* begin, uint8_t const* end) {
+    return llvm::hash_combine_range(begin, end);
+}
+
+void StackMap::removeSpillSet(StatepointRecord const& record) {
+    if (record.numSpills == 0)
+        return;
+    uint8_t const* begin = spillSets.data() + record.spillSet;
+    uint8_t const* end = begin;
+    for (uint32_t i = 0; i < record.numSpills; ++i)
+        decode(end);
+
+    auto range = spillSetIndex.equal_range(hash(begin, end));
+    auto i = range.first;
+    while (i != range.second && i->second.start != record.spillSet)
+        ++i;
+    assert(i != range.second);
+    if (--i->second.uses == 0) {
+        deadBytes += i->second.length;
+        spillSetIndex.erase(i);
+    }
+}
 
-        i++;
+void StackMap::unregisterStatepoints(uintptr_t begin, uintptr_t end) {
+    StatepointRecord lo = {begin, 0, 0};
+    StatepointRecord hi = {end, 0, 0};
+    auto first = std::lower_bound(statepoints.begin(), statepoints.end(), lo);
+    auto last = std::lower_bound(first, statepoints.end(), hi);
+    for (auto i = first; i != last; ++i)
+        removeSpillSet(*i);
+    statepoints.erase(first, last);
+
+    // compact the spill sets once most of them are unused
+    if (deadBytes * 2 <= spillSets.size())
+        return;
+    std::vector<uint8_t> live;
+    live.reserve(spillSets.size() - deadBytes);
+    std::unordered_map<uint32_t, uint32_t> moved;
+    for (auto& s : spillSetIndex) {
+        SpillSet& set = s.second;
+        uint8_t const* bytes = spillSets.data() + set.start;
+        moved[set.start] = live.size();
+        set.start = live.size();
+        live.insert(live.end(), bytes, bytes + set.length);
     }
+    for (auto& r : statepoints)
+        if (r.numSpills)
+            r.spillSet = moved.at(r.spillSet);
+    spillSets.swap(live);
+    deadBytes = 0;
 }
 
 unsigned StackMap::genericStatepointID = 0xABCDEF00;
-std::unordered_map<uintptr_t, StackMap::StatepointRecord> StackMap::statepoint;
-std::unordered_map<uint64_t, uintptr_t> StackMap::patchpoint;
+std::vector<StackMap::StatepointRecord> StackMap::statepoints;
+std::vector<uint8_t> StackMap::spillSets;
+std::unordered_multimap<size_t, StackMap::SpillSet> StackMap::spillSetIndex;
+size_t StackMap::deadBytes = 0;
 }
@@ -6,6 +6,8 @@
 #include "StackMapParser.h"
 
 #include <unordered_map>
+#include <vector>
+#include <string>
 #include <iostream>
 
 namespace rjit {
@@ -19,44 +21,111 @@ class StackMap {
   public:
     typedef std::unordered_map<uint64_t, uintptr_t> StackmapToFunction;
 
+    /** Statepoint decoded from the stackmap section when its module is
+      finalized.
+
+      The spilled gc pointers are described by their offsets from the stack
+      pointer at the call. The offsets are stored in the shared spillSets
+      table starting at byte spillSet. Records are kept sorted by their return
+      address so that the stack scanner only needs a binary search and a short
+      linear read per frame, without parsing the stackmaps again.
+     */
     struct StatepointRecord {
-        stackmap_t stackmap;
-        unsigned idx;
-        uintptr_t fun;
+        uintptr_t pc;
+        uint32_t spillSet;
+        uint32_t numSpills;
+
+        /** Calls visit(offset) for every spilled gc pointer.
+         */
+        template <typename F>
+        void forEachSpill(F visit) const {
+            uint8_t const* p = spillSets.data() + spillSet;
+            int32_t offset = 0;
+            for (uint32_t i = 0; i < numSpills; ++i) {
+                offset += decode(p);
+                visit(offset);
+            }
+        }
+
+        bool operator<(StatepointRecord const& other) const {
+            return pc < other.pc;
+        }
     };
 
-    static bool isStatepoint(uintptr_t pc);
-
-    static StackMapParserT::RecordAccessor getStatepoint(uintptr_t pc);
-
-    static unsigned getStackSize(uintptr_t pc);
+    /** Returns the record of the statepoint with given return address, or
+      nullptr if pc is not a statepoint.
+     */
+    static StatepointRecord const* findStatepoint(uintptr_t pc);
 
-    static uintptr_t isPatchpoint(uint64_t id) { return patchpoint.count(id); }
-
-    static uintptr_t getPatchpoint(uint64_t id);
+    static bool isStatepoint(uintptr_t pc) {
+        return findStatepoint(pc) != nullptr;
+    }
 
     static unsigned genericStatepointID;
 
+    /** Removes the records of all statepoints with return address in [begin,
+      end), once the code holding them is freed.
+     */
+    static void unregisterStatepoints(uintptr_t begin, uintptr_t end);
+
     // record stackmaps will parse the stackmap section of the current module
     // and
     // index all entries.
-    static void
-    recordStackmaps(stackmap_t sm, const StackmapToFunction& safepoints,
-                    const std::unordered_map<uint64_t, unsigned>& patchpoints);
+    static void recordStackmaps(stackmap_t sm,
+                                const StackmapToFunction& safepoints);
 
   private:
-    // Statepoints are identified by their pc address as seen on the runtime
-    // stack while scanning for roots.
-    static void registerStatepoint(uintptr_t function, uintptr_t offset,
-                                   stackmap_t stackmap,
-                                   unsigned stackmapOffset);
+    static std::vector<StatepointRecord> statepoints;
 
-    // Patchpoints are identified by their unique id given at compile time
-    static void registerPatchpoint(uint64_t id, uintptr_t offset);
+    /** Sets of spill offsets, each one sorted and stored as zigzag varint
+      deltas. Statepoints spilling the same slots share one set.
+     */
+    static std::vector<uint8_t> spillSets;
 
-    static std::unordered_map<uintptr_t, StatepointRecord> statepoint;
+    struct SpillSet {
+        uint32_t start;
+        uint32_t length;
+        uint32_t uses;
+    };
 
-    static std::unordered_map<uint64_t, uintptr_t> patchpoint;
+    /** The sets in spillSets by the hash of their encoding. The encoding
+      itself is only stored in spillSets and compared in place.
+     */
+    static std::unordered_multimap<size_t, SpillSet> spillSetIndex;
+
+    /** Bytes of spillSets no longer used by any record.
+     */
+    static size_t deadBytes;
+
+    /** Returns the start of the set with given offsets in spillSets, adding
+      it if there is none yet.
+     */
+    static uint32_t addSpillSet(std::vector<int32_t>& offsets);
+
+    static void removeSpillSet(StatepointRecord const& record);
+
+    static size_t hash(uint8_t const* begin, uint8_t const* end);
+
+    static void encode(int32_t value, std::vector<uint8_t>& out) {
+        uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        while (v >= 0x80) {
+            out.push_back((uint8_t)(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back((uint8_t)v);
+    }
+
+    static int32_t decode(uint8_t const*& p) {
+        uint32_t v = 0;
+        unsigned shift = 0;
+        uint8_t b;
+        do {
+            b = *p++;
+            v |= (uint32_t)(b & 0x7f) << shift;
+            shift += 7;
+        } while (b & 0x80);
+        return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    }
 };
 }
 
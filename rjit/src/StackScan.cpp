@@ -1,23 +1,85 @@
 #include "StackScan.h"
 #include "StackMap.h"
 
+#include <atomic>
 #include <execinfo.h>
 #include <iostream>
 
 #include "RIntlns.h"
+#include "api.h"
 
 #include <dlfcn.h>
 #include <execinfo.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <unwind.h>
 
 extern void* __libc_stack_end;
 
+// RCNTXT* in R's Defn.h, we only ever follow its nextcontext
+extern "C" void* R_GlobalContext;
+
 namespace rjit {
 
-// FIXME: we need robust stack scanning with markers on stack instead of this
-//        hack
+thread_local FrameMarker StackScan::markers[maxMarkers];
+thread_local unsigned StackScan::depth = 0;
+thread_local uint64_t StackScan::stamps = 0;
+
+template <typename F>
+bool StackScan::walkFrames(F visit) {
+    if (not RJIT_FRAME_MARKERS)
+        return walkFramePointers(visit);
+    walkFrameMarkers(visit);
+    return true;
+}
+
 void StackScan::stackScanner(void (*forward_node)(SEXP)) {
+    walkFrames([forward_node](uintptr_t pc, uintptr_t frame) {
+        scanFrame(pc, frame, forward_node);
+    });
+}
+
+bool StackScan::returnAddresses(std::vector<uintptr_t>& pcs) {
+    return walkFrames([&pcs](uintptr_t pc, uintptr_t) { pcs.push_back(pc); });
+}
+
+void StackScan::stackWords(std::function<void(uintptr_t)> visit) {
+#ifdef __APPLE__
+    void* end = pthread_get_stackaddr_np(pthread_self());
+#else
+    void* end = __libc_stack_end;
+#endif
+    for (auto w = (uintptr_t*)__builtin_frame_address(0); w < end; ++w)
+        visit(*w);
+}
+
+unsigned StackScan::returnAddresses(uintptr_t* pcs, unsigned max) {
+    unsigned n = 0;
+    walkFrames([pcs, max, &n](uintptr_t pc, uintptr_t) {
+        if (n < max)
+            pcs[n++] = pc;
+    });
+    return n;
+}
+
+void StackScan::scanFrame(uintptr_t pc, uintptr_t frame,
+                          void (*forward_node)(SEXP)) {
+    auto r = StackMap::findStatepoint(pc);
+    if (!r)
+        return;
+
+    r->forEachSpill([frame, forward_node](int32_t offset) {
+        uintptr_t value = frame + offset;
+
+        assert(!value || *(int*)value);
+
+        forward_node(*(SEXP*)value);
+    });
+}
+
+// FIXME: this hack requires frame pointers in all frames, jitted or not
+template <typename F>
+bool StackScan::walkFramePointers(F visit) {
 
     struct layout {
         struct layout* bp;
@@ -38,28 +100,77 @@ void StackScan::stackScanner(void (*forward_node)(SEXP)) {
             ((long)bp & 3))
             break;
 
-        uintptr_t pos = (uintptr_t)bp->ret;
-
-        if (StackMap::isStatepoint(pos)) {
-            uintptr_t frame = (uintptr_t)(bp + 1);
-
-            const auto& R = StackMap::getStatepoint(pos);
-            for (const auto& Loc : R.locations()) {
-                if (Loc.getKind() == StackMapParserT::LocationKind::Direct) {
-                    // Statepoint args should be spilled =>
-                    // reg is == 7 (rsp)
-                    assert(Loc.getDwarfRegNum() == 7);
-
-                    uintptr_t value = frame + Loc.getOffset();
-
-                    assert(!value || *(int*)value);
-
-                    forward_node(*(SEXP*)value);
-                }
-            }
-        }
+        visit((uintptr_t)bp->ret, (uintptr_t)(bp + 1));
         num++;
         bp = bp->bp;
     }
+    // the outermost frame has no saved frame pointer
+    return bp == nullptr;
+}
+
+/** Only jitted frames are visited, C frames between them are skipped.
+
+  Frames left by a longjmp never pop their markers. A marker is only trusted
+  if
+  - its frame lies above the scanner's own frame,
+  - its canary still holds its stamp, the frames called after the longjmp
+    have not overwritten it,
+  - the R context active at its frame entry is still on the context stack,
+    the longjmp has unwound the contexts of all the frames it skipped.
+  The markers and the contexts are both ordered from the newest entry, so
+  they are walked together.
+ */
+template <typename F>
+void StackScan::walkFrameMarkers(F visit) {
+    uintptr_t here = (uintptr_t)__builtin_frame_address(0);
+    void* context = R_GlobalContext;
+    for (unsigned i = depth; i-- > 0;) {
+        FrameMarker& m = markers[i];
+        if (m.sp < here or *m.canary != m.stamp)
+            continue;
+        void* c = context;
+        // nextcontext is the first member of RCNTXT
+        while (c != nullptr and c != m.context)
+            c = *(void**)c;
+        if (c == nullptr)
+            continue;
+        context = c;
+        visit(*(uintptr_t*)(m.sp - sizeof(uintptr_t)), m.sp);
+    }
+}
+}
+
+using rjit::StackScan;
+
+extern "C" void pushFrameMarker(uint64_t* canary, uintptr_t sp) {
+    // markers at or below the new frame belong to frames left by a longjmp
+    unsigned depth = StackScan::depth;
+    while (depth > 0 and StackScan::markers[depth - 1].sp <= sp)
+        --depth;
+    if (depth == StackScan::maxMarkers)
+        error("jitted frames nested too deeply");
+    // a signal handler scanning the stack must only see complete markers
+    StackScan::depth = depth;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    *canary = ++StackScan::stamps;
+    StackScan::markers[depth] = {sp, R_GlobalContext, canary, *canary};
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    StackScan::depth = depth + 1;
+}
+
+extern "C" void unwindFrameMarkers(uint64_t* canary) {
+    // the frames above the caller's were left by a longjmp to its context
+    unsigned depth = StackScan::depth;
+    while (depth > 0 and StackScan::markers[depth - 1].canary != canary)
+        --depth;
+    assert(depth > 0 && "the caller's marker is gone");
+    StackScan::depth = depth;
 }
+
+extern "C" void popFrameMarker(uint64_t* canary) {
+    // drops the markers of frames left by a longjmp as well
+    unsigned depth = StackScan::depth;
+    while (depth > 0 and StackScan::markers[--depth].canary != canary)
+        ;
+    StackScan::depth = depth;
 }
@@ -1,14 +1,106 @@
 #ifndef STACK_SCAN_H
 #define STACK_SCAN_H
 
+#include <cstdint>
+#include <functional>
+#include <vector>
+
 #include "RDefs.h"
 
 namespace rjit {
 
+/** Marker of an active jitted frame.
+
+  When RJIT_FRAME_MARKERS is set, every jitted function pushes a marker on
+  entry and pops it before it returns (see createFrameMarkersPass). The
+  markers form a shadow stack of the jitted frames, which the stack scanner
+  follows instead of walking all frames via frame pointers.
+
+  Frames left by a longjmp never pop their markers, and their memory is
+  reused by the frames called afterwards. The shadow stack is therefore kept
+  outside of the frames. The markers are dropped deterministically when the
+  longjmp targets a context of jitted code: the closure call trampoline
+  returns into the frame which made the context, and that frame unwinds the
+  markers above its own (see unwindFrameMarkers).
+
+  This mode is UNSAFE. When the target is a context made by gnur itself
+  (applyClosure, try and the like), the markers of the frames left stay
+  until the next jitted frame returns. A GC in between, for instance while
+  the on.exit code of the target context runs, can still trust them. The
+  canary and context checks of walkFrameMarkers only catch the frames whose
+  memory has been reused, the scanner then forwards stale spill slots of
+  dead frames and corrupts the heap.
+ */
+struct FrameMarker {
+    /** Stack pointer of the frame. The return address of the call the frame
+      is currently executing is stored right below it.
+     */
+    uintptr_t sp;
+    /** R_GlobalContext when the frame was entered.
+     */
+    void* context;
+    /** Slot in the frame holding the stamp of the marker.
+     */
+    uint64_t* canary;
+    uint64_t stamp;
+};
+
 class StackScan {
   public:
     static void stackScanner(void (*forward_node)(SEXP));
+
+    /** Collects the return addresses of the frames on the stack, that is the
+      code which is still to be executed. Only jitted frames are reported
+      when frame markers are used.
+
+      Returns false if the frame pointer walk stopped before it reached the
+      outermost frame, in which case frames may be missing.
+     */
+    static bool returnAddresses(std::vector<uintptr_t>& pcs);
+
+    /** Calls visit for every word between the caller's frame and the base of
+      the stack, a conservative replacement of returnAddresses when that
+      fails.
+     */
+    static void stackWords(std::function<void(uintptr_t)> visit);
+
+    /** Stores up to max return addresses into pcs and returns their number.
+      Does not allocate, so it can be used from a signal handler.
+     */
+    static unsigned returnAddresses(uintptr_t* pcs, unsigned max);
+
+    /** Markers of the jitted frames, the most recently entered last.
+     */
+    static constexpr unsigned maxMarkers = 8192;
+    static thread_local FrameMarker markers[maxMarkers];
+    static thread_local unsigned depth;
+    static thread_local uint64_t stamps;
+
+  private:
+    static void scanFrame(uintptr_t pc, uintptr_t frame,
+                          void (*forward_node)(SEXP));
+
+    /** Calls visit(pc, frame) for every frame, see scanFrame. Returns false
+      if the walk did not reach the outermost frame.
+     */
+    template <typename F>
+    static bool walkFrames(F visit);
+
+    template <typename F>
+    static bool walkFramePointers(F visit);
+
+    template <typename F>
+    static void walkFrameMarkers(F visit);
 };
 }
 
+extern "C" void pushFrameMarker(uint64_t* canary, uintptr_t sp);
+
+extern "C" void popFrameMarker(uint64_t* canary);
+
+/** Drops the markers above the one with canary, called by a jitted frame
+  when a call which may have been the target of a longjmp returns.
+ */
+extern "C" void unwindFrameMarkers(uint64_t* canary);
+
 #endif
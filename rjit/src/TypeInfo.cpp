@@ -2,12 +2,15 @@
 #include "RIntlns.h"
 #include "Flags.h"
 
+#include <algorithm>
+
 namespace rjit {
 
 void TypeInfo::mergeAll(SEXP value) {
     addType(value);
     mergeAttrib(value);
     mergeSize(value);
+    mergeShape(value);
 }
 
 const EnumBitset<TypeInfo::Type> TypeInfo::addType(SEXP value) {
@@ -60,6 +63,137 @@ void TypeInfo::mergeSize(SEXP value) {
     mergeSize(s);
 }
 
+TypeInfo::Shape TypeInfo::shapeOf(SEXP value) {
+    SEXP attrib = ATTRIB(value);
+    if (attrib == R_NilValue)
+        return Shape::None;
+    if (OBJECT(value))
+        return Shape::Classed;
+
+    bool names = false;
+    bool dim = false;
+    bool dimnames = false;
+    for (; attrib != R_NilValue; attrib = CDR(attrib)) {
+        SEXP tag = TAG(attrib);
+        if (tag == R_NamesSymbol)
+            names = true;
+        else if (tag == R_DimSymbol)
+            dim = true;
+        else if (tag == R_DimNamesSymbol)
+            dimnames = true;
+        else
+            return Shape::Any;
+    }
+    if (names && !dim && !dimnames)
+        return Shape::Names;
+    if (dim && !names)
+        return dimnames ? Shape::DimNames : Shape::Dim;
+    return Shape::Any;
+}
+
+void TypeInfo::mergeShape(SEXP value) { mergeShape(shapeOf(value)); }
+
+bool ValueProfile::merge(SEXP value) {
+    ValueProfile old = *this;
+
+    // anything but a vector is large
+    Length l = Length::Large;
+    R_xlen_t n = -1;
+    switch (TYPEOF(value)) {
+    case REALSXP:
+    case STRSXP:
+    case VECSXP:
+    case INTSXP:
+    case LGLSXP:
+        n = XLENGTH(value);
+        l = n == 1 ? Length::Scalar
+                   : n <= smallLength ? Length::Small : Length::Large;
+        break;
+    default:
+        break;
+    }
+    if (l > length_)
+        length_ = l;
+
+    uint16_t fixed = n >= 0 && n < variesLength - 1 ? n + 1 : variesLength;
+    if (fixedLength_ == 0)
+        fixedLength_ = fixed;
+    else if (fixedLength_ != fixed)
+        fixedLength_ = variesLength;
+
+    // only scalars are checked for NA, nothing uses it for longer vectors
+    // yet and the fast path of recordType would have to scan them
+    if (n == 1) {
+        switch (TYPEOF(value)) {
+        case INTSXP:
+        case LGLSXP: {
+            int v = INTEGER(value)[0];
+            if (v == NA_INTEGER) {
+                na_ = true;
+            } else {
+                min_ = std::min(min_, v);
+                max_ = std::max(max_, v);
+            }
+            break;
+        }
+        case REALSXP:
+            if (ISNAN(REAL(value)[0]))
+                na_ = true;
+            break;
+        case STRSXP:
+            if (STRING_ELT(value, 0) == NA_STRING)
+                na_ = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return old.length_ != length_ || old.na_ != na_ ||
+           old.fixedLength_ != fixedLength_ || old.min_ != min_ ||
+           old.max_ != max_;
+}
+
+void ValueProfile::merge(ValueProfile const& other) {
+    if (other.length_ > length_)
+        length_ = other.length_;
+    na_ = na_ || other.na_;
+    if (fixedLength_ == 0)
+        fixedLength_ = other.fixedLength_;
+    else if (other.fixedLength_ != 0 && other.fixedLength_ != fixedLength_)
+        fixedLength_ = variesLength;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+}
+
+std::ostream& operator<<(std::ostream& out, ValueProfile const& profile) {
+    out << "[";
+    switch (profile.length()) {
+    case ValueProfile::Length::Unknown:
+        out << "??";
+        break;
+    case ValueProfile::Length::Scalar:
+        out << "scalar";
+        break;
+    case ValueProfile::Length::Small:
+        out << "small";
+        break;
+    case ValueProfile::Length::Large:
+        out << "large";
+        break;
+    default:
+        assert(false);
+    }
+    if (profile.fixedLength() >= 0)
+        out << " length " << profile.fixedLength();
+    if (profile.hasRange())
+        out << " " << profile.min() << ".." << profile.max();
+    if (profile.naSeen())
+        out << " NA";
+    out << "]";
+    return out;
+}
+
 std::ostream& operator<<(std::ostream& out, TypeInfo& info) {
     auto t = info.types();
     out << "[(";
@@ -109,6 +243,33 @@ std::ostream& operator<<(std::ostream& out, TypeInfo& info) {
     default:
         assert(false);
     }
+
+    out << " ";
+    switch (info.shape()) {
+    case TypeInfo::Shape::Unknown:
+        out << "??";
+        break;
+    case TypeInfo::Shape::None:
+        out << "{}";
+        break;
+    case TypeInfo::Shape::Names:
+        out << "{names}";
+        break;
+    case TypeInfo::Shape::Dim:
+        out << "{dim}";
+        break;
+    case TypeInfo::Shape::DimNames:
+        out << "{dim,dimnames}";
+        break;
+    case TypeInfo::Shape::Classed:
+        out << "{class}";
+        break;
+    case TypeInfo::Shape::Any:
+        out << "{?}";
+        break;
+    default:
+        assert(false);
+    }
     out << "]";
 
     return out;
@@ -4,6 +4,7 @@
 #include "EnumBitset.h"
 #include <iostream>
 #include <cassert>
+#include <limits>
 
 #include "RDefs.h"
 
@@ -11,8 +12,8 @@ namespace rjit {
 
 /* TypeInfo
  * holds type and shape information about a variable or register
- * Currently it contains: a set of possible types, whether it has attrs and the
- * size class (ie. if its scalar).
+ * Currently it contains: a set of possible types, whether it has attrs, the
+ * size class (ie. if its scalar) and the shape (which attributes it has).
  */
 class TypeInfo {
   public:
@@ -24,6 +25,22 @@ class TypeInfo {
 
     enum class Attrib : uint8_t { Unknown, Absent, Object, Any };
 
+    /** The attributes a value carries, like the hidden class of an object.
+
+      None means no attributes at all, Names only names, Dim only dim, DimNames
+      dim and dimnames, Classed any attributes of an object. Everything else,
+      or values of different shapes, is Any.
+     */
+    enum class Shape : uint8_t {
+        Unknown,
+        None,
+        Names,
+        Dim,
+        DimNames,
+        Classed,
+        Any
+    };
+
     // -- Constructors
 
     // Init unused bits to zero
@@ -31,12 +48,18 @@ class TypeInfo {
         store.types_ = EnumBitset<Type>();
         store.size_ = Size::Unknown;
         store.attrib_ = Attrib::Unknown;
+        store.shape_ = Shape::Unknown;
     }
 
-    TypeInfo(Type type, Size size, Attrib attrib) : TypeInfo(0) {
+    TypeInfo(Type type, Size size, Attrib attrib)
+        : TypeInfo(type, size, attrib,
+                   attrib == Attrib::Absent ? Shape::None : Shape::Any) {}
+
+    TypeInfo(Type type, Size size, Attrib attrib, Shape shape) : TypeInfo(0) {
         store.types_ = EnumBitset<Type>(type);
         store.size_ = size;
         store.attrib_ = attrib;
+        store.shape_ = shape;
     }
 
     TypeInfo(SEXP from) : TypeInfo() { mergeAll(from); }
@@ -65,17 +88,18 @@ class TypeInfo {
         any.addType(Type::Any);
         any.store.size_ = Size::Any;
         any.store.attrib_ = Attrib::Any;
+        any.store.shape_ = Shape::Any;
         return any;
     }
 
     bool isBottom() {
         return types().empty() && attrib() == Attrib::Unknown &&
-               size() == Size::Unknown;
+               size() == Size::Unknown && shape() == Shape::Unknown;
     }
 
     bool isAny() {
         return types().has(Type::Any) && attrib() == Attrib::Any &&
-               size() == Size::Any;
+               size() == Size::Any && shape() == Shape::Any;
     }
 
     const EnumBitset<Type> types() { return EnumBitset<Type>(store.types_); }
@@ -84,6 +108,8 @@ class TypeInfo {
 
     Size size() { return store.size_; }
 
+    Shape shape() { return store.shape_; }
+
     // -- setters
 
     bool hasType(Type t) { return types().has(t) || types().has(Type::Any); }
@@ -109,11 +135,23 @@ class TypeInfo {
         return a;
     }
 
+    Shape shape(Shape s) {
+        assert(s > Shape::Unknown && s <= Shape::Any);
+        store.shape_ = s;
+        return s;
+    }
+
+    /** Returns the shape of value. Values without attributes, the common
+      case, take a single comparison.
+     */
+    static Shape shapeOf(SEXP value);
+
     // -- record a new runtime type instance
 
     const EnumBitset<Type> addType(SEXP value);
     void mergeAttrib(SEXP v);
     void mergeSize(SEXP v);
+    void mergeShape(SEXP v);
     void mergeAll(SEXP s);
 
     // -- merge two typeinfos
@@ -121,10 +159,12 @@ class TypeInfo {
     bool mergeTypes(TypeInfo other) { return mergeTypes(other.types()); }
     bool mergeAttrib(TypeInfo other) { return mergeAttrib(other.attrib()); }
     bool mergeSize(TypeInfo other) { return mergeSize(other.size()); }
+    bool mergeShape(TypeInfo other) { return mergeShape(other.shape()); }
 
     bool mergeWith(TypeInfo other) {
         bool result = mergeTypes(other);
         result = mergeAttrib(other) or result;
+        result = mergeShape(other) or result;
         return mergeSize(other) or result;
     }
 
@@ -161,6 +201,16 @@ class TypeInfo {
         }
     }
 
+    /** Shapes other than Unknown and Any are not ordered, two different ones
+      merge to Any.
+     */
+    bool mergeShape(Shape s) {
+        if (s == Shape::Unknown || s == shape() || shape() == Shape::Any)
+            return false;
+        shape(shape() == Shape::Unknown ? s : Shape::Any);
+        return true;
+    }
+
     bool mergeTypes(EnumBitset<Type> t) {
         if ((t | types()) != types()) {
             types(t | types());
@@ -180,6 +230,7 @@ class TypeInfo {
         int types_ : (int)Type::Any + 1;
         Attrib attrib_ : 8;
         Size size_ : 8;
+        Shape shape_ : 8;
     };
 
     static_assert(sizeof(Store) == sizeof(int), "Store must fit into int");
@@ -191,6 +242,81 @@ static_assert(sizeof(TypeInfo) == sizeof(int),
               "Typeinfo cannot be bigger than its Store");
 
 std::ostream& operator<<(std::ostream& out, TypeInfo& info);
+
+/* ValueProfile
+ * extends the TypeInfo of a type feedback slot with what the optimizer needs
+ * to drop bounds and overflow checks: the length class of the values, their
+ * length if it never changed, the range of integer and logical scalars and
+ * whether a scalar NA was seen.
+ * The fast path of recordType (fastpaths/intrinsics.c) relies on the layout.
+ */
+class ValueProfile {
+  public:
+    enum class Length : uint8_t { Unknown, Scalar, Small, Large };
+
+    /** Vectors up to this length are small.
+     */
+    static constexpr int smallLength = 16;
+
+    /** Integers within +-smallInt cannot overflow when added, subtracted or
+      multiplied with each other.
+     */
+    static constexpr int smallInt = 46340;
+
+    // The empty range, min > max
+    ValueProfile()
+        : length_(Length::Unknown), na_(false), fixedLength_(0),
+          min_(std::numeric_limits<int>::max()),
+          max_(std::numeric_limits<int>::min()) {}
+
+    Length length() const { return length_; }
+
+    /** Returns the length of all recorded values, or -1 if it differed (or
+      did not fit).
+     */
+    int fixedLength() const {
+        return fixedLength_ == 0 || fixedLength_ == variesLength
+                   ? -1
+                   : fixedLength_ - 1;
+    }
+
+    bool naSeen() const { return na_; }
+
+    bool hasRange() const { return min_ <= max_; }
+    int min() const { return min_; }
+    int max() const { return max_; }
+
+    /** True if all recorded values were integer or logical scalars other
+      than NA, within +-smallInt.
+     */
+    bool smallScalars() const {
+        return length_ == Length::Scalar && !na_ && hasRange() &&
+               min_ >= -smallInt && max_ <= smallInt;
+    }
+
+    /** Records value, returns true if the profile changed.
+     */
+    bool merge(SEXP value);
+
+    /** Records all the values other recorded.
+     */
+    void merge(ValueProfile const& other);
+
+  private:
+    static constexpr uint16_t variesLength = 0xffff;
+
+    Length length_;
+    bool na_;
+    // length + 1, 0 before the first value
+    uint16_t fixedLength_;
+    int min_;
+    int max_;
+};
+
+static_assert(sizeof(ValueProfile) == 3 * sizeof(int),
+              "ValueProfile must fit into three ints");
+
+std::ostream& operator<<(std::ostream& out, ValueProfile const& profile);
 }
 
 #endif
@@ -42,7 +42,8 @@ PointerType* initializeTypes() {
     fields = {t::Int, t::Int};
     t_vecsxp_struct->setBody(fields, false);
 
-    fields = {t_sxpinfo_struct, t_vecsxp_struct, t::SEXP, t::SEXP, t::SEXP};
+    // the header of the other SEXPs (sxpinfo, attrib, next, prev) comes first
+    fields = {t_sxpinfo_struct, t::SEXP, t::SEXP, t::SEXP, t_vecsxp_struct};
     t::VECTOR_SEXPREC = StructType::create(context, "struct.VECTOR_SEXPREC");
     t::VECTOR_SEXPREC->setBody(fields, false);
 
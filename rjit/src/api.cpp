@@ -5,6 +5,9 @@
 
 #include <llvm/IR/Module.h>
 
+#include <algorithm>
+#include <sstream>
+
 #include "Compiler.h"
 
 #include "api.h"
@@ -18,6 +21,12 @@
 #include "Flags.h"
 
 #include "StackScan.h"
+#include "Protect.h"
+#include "CodeRegion.h"
+#include "Profiler.h"
+#include "Sampler.h"
+#include "IntrinsicCounters.h"
+#include "CompilePolicy.h"
 
 using namespace rjit;
 
@@ -30,6 +39,22 @@ REXPORT SEXP jitAst(SEXP ast, SEXP formals, SEXP rho) {
     return result;
 }
 
+/** Compiles the body and the default arguments of a closure into one module
+  and returns a new closure in rho.
+ */
+REXPORT SEXP jitClosure(SEXP ast, SEXP formals, SEXP rho) {
+    Protect p;
+    SEXP forms, body;
+    {
+        // the finalized compiler must be gone before we allocate again
+        Compiler c("module");
+        forms = p(c.compileFormals(formals));
+        body = p(c.compile("rfunction", ast, forms));
+        c.finalize();
+    }
+    return mkCLOSXP(forms, body, rho);
+}
+
 REXPORT SEXP jitPrintTypefeedback(SEXP f) {
     if (TYPEOF(f) == CLOSXP)
         f = BODY(f);
@@ -41,17 +66,29 @@ REXPORT SEXP jitPrintTypefeedback(SEXP f) {
     SEXP consts = CDR(f);
     SEXP typefeedback = VECTOR_ELT(consts, 1);
     SEXP typefeedbackName = VECTOR_ELT(consts, 2);
-    assert(XLENGTH(typefeedback) == XLENGTH(typefeedbackName));
+    assert(FeedbackSlot::count(typefeedback) ==
+           (size_t)XLENGTH(typefeedbackName));
 
+    // printed through R, so that the output can be captured
+    std::ostringstream out;
     SEXP invocationCount = VECTOR_ELT(consts, 3);
-    std::cout << "Invocation count: " << INTEGER(invocationCount)[0] << "\n";
+    out << "Invocation count: " << INTEGER(invocationCount)[0] << "\n";
 
-    for (int i = 0; i < XLENGTH(typefeedback); ++i) {
-        TypeInfo info(INTEGER(typefeedback)[i]);
-        SEXP sym = VECTOR_ELT(typefeedbackName, i);
-        std::cout << CHAR(PRINTNAME(sym)) << ": " << info << "\n";
+    FeedbackSlot* slots = FeedbackSlot::slots(typefeedback);
+    for (int i = 0; i < XLENGTH(typefeedbackName); ++i) {
+        SEXP key = VECTOR_ELT(typefeedbackName, i);
+        // call results are keyed by the call
+        if (TYPEOF(key) == LANGSXP)
+            out << (TYPEOF(CAR(key)) == SYMSXP ? CHAR(PRINTNAME(CAR(key)))
+                                               : "<call>")
+                << "(...)";
+        else
+            out << CHAR(PRINTNAME(key));
+        out << ": " << slots[i].info << " " << slots[i].profile << "\n";
     }
 
+    Rprintf("%s", out.str().c_str());
+
     return R_NilValue;
 }
 
@@ -91,6 +128,60 @@ REXPORT SEXP jitFunctions(SEXP moduleName, SEXP functions) {
     return moduleName;
 }
 
+/** Compiles all closures bound in the given environment (typically a
+  namespace).
+
+  The closures are compiled in batches of moduleSize functions, each batch
+  into a single module. This amortizes the per module costs (execution engine,
+  code generation, relocations and stackmaps) that dominate when compiling a
+  package one function at a time. Bodies are only replaced once the batch's
+  module is finalized, so no code can run a NATIVESXP which is not linked yet.
+
+  Already compiled closures are skipped. Returns the number of compiled
+  closures.
+ */
+REXPORT SEXP jitEnvironment(SEXP env, SEXP moduleName, SEXP moduleSize) {
+    if (TYPEOF(env) != ENVSXP)
+        error("environment expected");
+    if (TYPEOF(moduleName) != STRSXP or XLENGTH(moduleName) < 1)
+        error("module name must be a character string");
+    char const* mName = CHAR(STRING_ELT(moduleName, 0));
+    int batchSize = asInteger(moduleSize);
+    if (batchSize == NA_INTEGER or batchSize <= 0)
+        error("module size must be positive");
+
+    // forcing the bindings (lazy loading) may run arbitrary R code, so first
+    // collect the closures and only then start compiling
+    Protect p;
+    SEXP names = p(R_lsInternal(env, TRUE));
+    SEXP closures = p(allocVector(VECSXP, XLENGTH(names)));
+    int n = 0;
+    for (int i = 0; i < XLENGTH(names); ++i) {
+        SEXP f = findVarInFrame(env, install(CHAR(STRING_ELT(names, i))));
+        if (TYPEOF(f) == PROMSXP)
+            f = eval(f, env);
+        if (TYPEOF(f) != CLOSXP or TYPEOF(BODY(f)) == NATIVESXP)
+            continue;
+        SET_VECTOR_ELT(closures, n, f);
+        SET_STRING_ELT(names, n++, STRING_ELT(names, i));
+    }
+
+    for (int start = 0; start < n; start += batchSize) {
+        int end = std::min(start + batchSize, n);
+        std::vector<SEXP> natives;
+        Compiler c(mName);
+        for (int i = start; i < end; ++i) {
+            SEXP f = VECTOR_ELT(closures, i);
+            natives.push_back(c.compileFunction(CHAR(STRING_ELT(names, i)),
+                                                BODY(f), FORMALS(f)));
+        }
+        c.finalize();
+        for (int i = start; i < end; ++i)
+            SET_BODY(VECTOR_ELT(closures, i), natives[i - start]);
+    }
+    return ScalarInteger(n);
+}
+
 /** Returns the constant pool associated with the given NATIVESXP.
  */
 REXPORT SEXP jitConstants(SEXP expression) {
@@ -109,6 +200,67 @@ REXPORT SEXP jitLLVM(SEXP expression) {
     return R_NilValue;
 }
 
+/** Returns the number of live code regions and the bytes of memory they hold.
+ */
+REXPORT SEXP jitCodeMemory() {
+    SEXP result = PROTECT(allocVector(REALSXP, 2));
+    REAL(result)[0] = CodeRegion::liveRegions();
+    REAL(result)[1] = CodeRegion::liveBytes();
+    SEXP names = PROTECT(allocVector(STRSXP, 2));
+    SET_STRING_ELT(names, 0, mkChar("regions"));
+    SET_STRING_ELT(names, 1, mkChar("bytes"));
+    setAttrib(result, R_NamesSymbol, names);
+    UNPROTECT(2);
+    return result;
+}
+
+/** Returns the compile time and runtime profile of the NATIVESXPs compiled
+  while the profile flag was set, as a data frame.
+ */
+REXPORT SEXP jitProfile() { return Profiler::report(); }
+
+/** Starts sampling the stack every interval (a number of seconds) of cpu
+  time.
+ */
+REXPORT SEXP jitStartSampling(SEXP interval) {
+    if (TYPEOF(interval) != REALSXP || XLENGTH(interval) < 1 ||
+        REAL(interval)[0] <= 0) {
+        warning("interval not a positive number");
+        return R_NilValue;
+    }
+    Sampler::start((unsigned)std::max(1.0, REAL(interval)[0] * 1e6));
+    return R_NilValue;
+}
+
+REXPORT SEXP jitStopSampling() {
+    Sampler::stop();
+    return R_NilValue;
+}
+
+/** Returns the samples per jitted function as a data frame.
+ */
+REXPORT SEXP jitSamples() { return Sampler::report(); }
+
+/** Returns the counts of the intrinsic call sites compiled while the
+  countIntrinsics flag was set, as a data frame.
+ */
+REXPORT SEXP jitIntrinsicCounts() { return IntrinsicCounters::report(); }
+
+REXPORT SEXP jitResetIntrinsicCounts() {
+    IntrinsicCounters::reset();
+    return R_NilValue;
+}
+
+/** Sets the fraction of time compileIC may spend compiling and the AST size
+  up to which bodies are compiled on their first call, see CompilePolicy.
+ */
+REXPORT SEXP jitSetCompilePolicy(SEXP budget, SEXP smallFunction) {
+    CompilePolicy::configure(asReal(budget), asInteger(smallFunction));
+    return R_NilValue;
+}
+
+REXPORT SEXP jitCompileStats() { return CompilePolicy::stats(); }
+
 REXPORT SEXP printWithoutSP(SEXP expr, SEXP formals) {
     Compiler c("module");
     SEXP result = c.compile("rfunction", expr, formals);
@@ -121,16 +273,31 @@ REXPORT SEXP printWithoutSP(SEXP expr, SEXP formals) {
 int RJIT_COMPILE = getenv("RJIT_COMPILE") ? atoi(getenv("RJIT_COMPILE")) : 0;
 // The status of R_ENABLE_JIT variable used by gnur
 int R_ENABLE_JIT = getenv("R_ENABLE_JIT") ? atoi(getenv("R_ENABLE_JIT")) : 0;
+static int R_ENABLE_JIT_ENV = R_ENABLE_JIT;
 
 int RJIT_DEBUG = getenv("RJIT_DEBUG") ? atoi(getenv("RJIT_DEBUG")) : 0;
 
+// Should jitted frames register markers for the stack scanner instead of
+// keeping frame pointers. Must not change once code has been compiled.
+// UNSAFE, markers of frames left by a longjmp to a gnur context can be
+// scanned (see FrameMarker).
+int RJIT_FRAME_MARKERS =
+    getenv("RJIT_FRAME_MARKERS") ? atoi(getenv("RJIT_FRAME_MARKERS")) : 0;
+
 REXPORT SEXP jitDisable(SEXP expression) {
     RJIT_COMPILE = false;
+    R_ENABLE_JIT = R_ENABLE_JIT_ENV;
     return R_NilValue;
 }
 
-REXPORT SEXP jitEnable(SEXP expression) {
-    RJIT_COMPILE = true;
+/** Compiles closures when they are called. Automatic compilation does so as
+  in place of the bytecode compiler, subject to the CompilePolicy.
+ */
+REXPORT SEXP jitEnable(SEXP automatic) {
+    if (asLogical(automatic) == TRUE)
+        R_ENABLE_JIT = 5;
+    else
+        RJIT_COMPILE = true;
     return R_NilValue;
 }
 
@@ -180,9 +347,18 @@ REXPORT SEXP setFlag(SEXP name, SEXP value) {
         rjit::Flag::singleton().printOptIR = val;
         return R_NilValue;
     }
+    if (strcmp("profile", flag) == 0) {
+        rjit::Flag::singleton().profile = val;
+        return R_NilValue;
+    }
+    if (strcmp("countIntrinsics", flag) == 0) {
+        rjit::Flag::singleton().countIntrinsics = val;
+        return R_NilValue;
+    }
     std::cout << "Unknown flag : " << flag << "\n";
     std::cout << " Valid flags are: recordTypes, recompileHot, "
-              << "staticNamedMatch, unsafeNA, printIR, printOptIR\n";
+              << "staticNamedMatch, unsafeNA, printIR, printOptIR, profile, "
+              << "countIntrinsics\n";
     return R_NilValue;
 }
 
@@ -192,6 +368,10 @@ void rjit_gcCallback(void (*forward_node)(SEXP)) {
     Compiler::gcCallback(forward_node);
     StackScan::stackScanner(forward_node);
     Compiler::gcCallback(forward_node);
+    Profiler::gcCallback(forward_node);
+    CompilePolicy::gcCallback(forward_node);
+    // drain the sample buffer regularly
+    Sampler::aggregate();
 }
 
 int rjitStartup() {
@@ -6,6 +6,7 @@
 extern int RJIT_COMPILE;
 extern int R_ENABLE_JIT;
 extern int RJIT_DEBUG;
+extern int RJIT_FRAME_MARKERS;
 
 extern int rjit_startup;
 
@@ -0,0 +1,148 @@
+/* Fast paths of rjit intrinsics.
+
+   This file is not part of the package sources. It is compiled to LLVM
+   bitcode by clang (see CMakeLists.txt) and linked into every jitted module
+   by FastPaths, so that the optimizer can inline the intrinsics below into
+   the jitted code. Calls which are not inlined still go to the intrinsics in
+   gnur.
+
+   SEXPs in jitted code are pointers to struct.SEXPREC in address space 1,
+   the structures here must stay isomorphic to the ones in Types.cpp for the
+   linker to map them onto each other.
+
+   Fast paths must not allocate. Where they would, they call a slow path
+   instead, which is an ordinary function. Calls to functions declared here
+   are made safepoints when the bitcode is linked.
+ */
+
+#define JIT __attribute__((address_space(1)))
+
+#define LGLSXP 10
+#define INTSXP 13
+#define REALSXP 14
+#define STRSXP 16
+#define NA_LOGICAL (-2147483647 - 1)
+#define TYPE_MASK 31
+
+struct sxpinfo_struct {
+    int bits;
+};
+
+struct SEXPREC;
+typedef struct SEXPREC JIT* SEXP;
+
+struct SEXPREC {
+    struct sxpinfo_struct sxpinfo;
+    SEXP attrib;
+    SEXP next;
+    SEXP prev;
+    struct {
+        SEXP car;
+        SEXP cdr;
+        SEXP tag;
+    } u;
+};
+
+struct vecsxp_struct {
+    int length;
+    int truelength;
+};
+
+/* Vectors in gnur share the header of the other SEXPs, the length follows
+   it and the data follows the length. */
+struct vector_header {
+    struct sxpinfo_struct sxpinfo;
+    SEXP attrib;
+    SEXP next;
+    SEXP prev;
+    struct vecsxp_struct vecsxp;
+};
+
+/* The sxpinfo is padded to the alignment of the pointers. */
+_Static_assert(__builtin_offsetof(struct vector_header, vecsxp) ==
+                   4 * sizeof(void*),
+               "the length must follow the header of the SEXPs");
+_Static_assert(sizeof(struct vector_header) == 5 * sizeof(void*),
+               "the data must follow the length");
+
+typedef struct vector_header JIT* VECSEXP;
+
+static inline int type(SEXP what) { return what->sxpinfo.bits & TYPE_MASK; }
+
+static inline int length(SEXP what) { return ((VECSEXP)what)->vecsxp.length; }
+
+static inline int JIT* logical(SEXP what) {
+    return (int JIT*)((VECSEXP)what + 1);
+}
+
+static inline double JIT* real(SEXP what) {
+    return (double JIT*)((VECSEXP)what + 1);
+}
+
+static inline SEXP JIT* strings(SEXP what) {
+    return (SEXP JIT*)((VECSEXP)what + 1);
+}
+
+extern SEXP R_NilValue;
+extern SEXP R_NaString;
+
+int sexpType(SEXP what) { return type(what); }
+
+int convertToLogicalNoNASlow(SEXP what, SEXP consts, int callIdx);
+
+/* Scalar logicals other than NA are the common case of if and while
+   conditions, everything else (coercion, warnings and errors) is left to
+   gnur. */
+int convertToLogicalNoNA(SEXP what, SEXP consts, int callIdx) {
+    if (type(what) == LGLSXP && length(what) == 1) {
+        int result = *logical(what);
+        if (result != NA_LOGICAL)
+            return result;
+    }
+    return convertToLogicalNoNASlow(what, consts, callIdx);
+}
+
+/* A slot of the typefeedback vector, see FeedbackSlot and ValueProfile. */
+struct feedback_slot {
+    int info;
+    unsigned char length;
+    unsigned char na;
+    unsigned short fixedLength;
+    int min;
+    int max;
+    int seenType;
+};
+
+typedef struct feedback_slot JIT* SLOT;
+
+void recordTypeSlow(SEXP value, SEXP store, int idx);
+
+/* Once all values of a slot were vectors of the same type and length
+   without attributes, another such value only changes the slot through its
+   value profile. Only scalars contribute to the profile, whose range and NA
+   bit are checked here. */
+void recordType(SEXP value, SEXP store, int idx) {
+    SLOT slot = (SLOT)((VECSEXP)store + 1) + idx;
+    int t = type(value);
+    if (t == slot->seenType && value->attrib == R_NilValue &&
+        length(value) + 1 == slot->fixedLength) {
+        if (length(value) != 1) {
+            return;
+        } else if (t == INTSXP || t == LGLSXP) {
+            int v = *logical(value);
+            if (v == NA_LOGICAL ? slot->na
+                                : v >= slot->min && v <= slot->max)
+                return;
+        } else if (t == REALSXP) {
+            double v = *real(value);
+            if (slot->na || v == v)
+                return;
+        } else if (t == STRSXP) {
+            if (slot->na || *strings(value) != R_NaString)
+                return;
+        } else {
+            return;
+        }
+    }
+    recordTypeSlow(value, store, idx);
+}
@@ -99,6 +99,8 @@ class ScalarsTracking : public ir::ForwardDriver<ScalarsTrackingPass> {
   public:
     typedef TrackingValue Value;
     typedef ir::AState<Value> State;
+
+    const char* getPassName() const override { return "ScalarsTracking"; }
 };
 
 } // namespace analysis
@@ -17,7 +17,25 @@ class TypeAndShapePass : public ir::Fixpoint<ir::AState<TypeInfo>> {
     typedef TypeInfo Value;
     typedef ir::AState<Value> State;
 
-    void constantLoad(SEXP c, ir::Value p) { state[p] = TypeInfo(c); }
+    /** Integer and logical feedback is trusted to stay small only with
+      unsafeOpt. Nothing guards the value profiles, the type checks are
+      assertions which do not fall back to generic code.
+     */
+    static bool smallScalars() {
+        return Flag::singleton().unsafeOpt && !Flag::singleton().unsafeNA;
+    }
+
+    /** Integer constants too large for the small scalars of value profiles
+      could overflow the scalar operations of the Scalars pass.
+     */
+    void constantLoad(SEXP c, ir::Value p) {
+        TypeInfo t(c);
+        if (smallScalars() && TYPEOF(c) == INTSXP &&
+            XLENGTH(c) == 1 && (INTEGER(c)[0] < -ValueProfile::smallInt ||
+                                INTEGER(c)[0] > ValueProfile::smallInt))
+            t.addType(TypeInfo::Type::Any);
+        state[p] = t;
+    }
 
     match constant(ir::UserLiteral* p) { constantLoad(p->indexValue(), p); }
 
@@ -26,8 +44,12 @@ class TypeAndShapePass : public ir::Fixpoint<ir::AState<TypeInfo>> {
         auto rhs = p->rhs();
         auto l = state[lhs];
         auto r = state[rhs];
-        state[p->pattern()] = Value::merge(l, r);
-        // state[p->pattern()] = Value::merge(state[lhs], state[rhs]);
+        Value result = Value::merge(l, r);
+        // only the operands are known to be small, the result may overflow
+        // when used again
+        if (smallScalars() && result.hasOnlyType(Value::Type::Integer))
+            result.addType(Value::Type::Any);
+        state[p->pattern()] = result;
     }
 
     /** If we have information about the variable, store it to the register,
@@ -41,16 +63,7 @@ class TypeAndShapePass : public ir::Fixpoint<ir::AState<TypeInfo>> {
             return;
         }
         if (Flag::singleton().useTypefeedback && typeFeedback) {
-            TypeInfo inf = typeFeedback->get(symbol);
-
-            // We cannot guard integer overflow to NA yet:
-            if (!Flag::singleton().unsafeNA &&
-                (inf.hasOnlyType(TypeInfo::Type::Integer) ||
-                 inf.hasOnlyType(TypeInfo::Type::Bool))) {
-                inf.addType(TypeInfo::Type::Any);
-            }
-
-            state[dest] = inf;
+            state[dest] = feedback(dest);
             return;
         }
 
@@ -83,10 +96,15 @@ class TypeAndShapePass : public ir::Fixpoint<ir::AState<TypeInfo>> {
         }
     }
 
-    /** A call to ICStub invalidates all variables.
+    /** A call to ICStub invalidates all variables. Its result is what the
+     * call site returned so far, guarded by the compiler.
      */
     match call(ir::ICStub* ins) {
         state.invalidateVariables(Value::any());
+        if (Flag::singleton().useTypefeedback && typeFeedback) {
+            state[ins] = feedback(ins->result());
+            return;
+        }
         state[ins] =
             Value(Value::Type::Any, Value::Size::Any, Value::Attrib::Any);
     }
@@ -100,12 +118,32 @@ class TypeAndShapePass : public ir::Fixpoint<ir::AState<TypeInfo>> {
     }
 
     bool dispatch(llvm::BasicBlock::iterator& i) override;
+
+  private:
+    /** Returns the recorded type of a variable read or call result.
+     */
+    TypeInfo feedback(llvm::Value* site) {
+        TypeInfo inf = typeFeedback->get(site);
+
+        // We cannot guard integer overflow to NA, unless unsafeOpt lets us
+        // assume that scalars which never were NA and were small enough for
+        // the scalar operations not to overflow stay so:
+        if (!Flag::singleton().unsafeNA &&
+            (inf.hasOnlyType(TypeInfo::Type::Integer) ||
+             inf.hasOnlyType(TypeInfo::Type::Bool)) &&
+            !(smallScalars() && typeFeedback->profile(site).smallScalars())) {
+            inf.addType(TypeInfo::Type::Any);
+        }
+        return inf;
+    }
 };
 
 class TypeAndShape : public ir::ForwardDriver<TypeAndShapePass> {
   public:
     typedef TypeInfo Value;
     typedef ir::AState<Value> State;
+
+    const char* getPassName() const override { return "TypeAndShape"; }
 };
 
 } // namespace analysis
@@ -46,6 +46,8 @@ class VariablePass : public Pass {
 
 class VariableAnalysis : public LinearDriver<VariablePass> {
   public:
+    const char* getPassName() const override { return "VariableAnalysis"; }
+
     bool runOnFunction_(Function& f) override {
         pass.m = static_cast<JITModule*>(f.getParent());
         SEXP formals = pass.m->formals(&f);
@@ -8,6 +8,7 @@ using namespace llvm;
 #include "RIntlns.h"
 #include "Protect.h"
 #include "TypeInfo.h"
+#include "api.h"
 
 namespace rjit {
 namespace ir {
@@ -19,10 +20,13 @@ Builder::Context::Context(std::string const& name, JITModule* m,
     f = Function::Create(ty, Function::ExternalLinkage, name, m);
 
     f->setGC("rjit");
-    auto attrs = f->getAttributes();
-    attrs = attrs.addAttribute(f->getContext(), AttributeSet::FunctionIndex,
-                               "no-frame-pointer-elim", "true");
-    f->setAttributes(attrs);
+    // the stack scanner walks frame pointers unless frames have markers
+    if (not RJIT_FRAME_MARKERS) {
+        auto attrs = f->getAttributes();
+        attrs = attrs.addAttribute(f->getContext(), AttributeSet::FunctionIndex,
+                                   "no-frame-pointer-elim", "true");
+        f->setAttributes(attrs);
+    }
 
     // create first basic block
     b = llvm::BasicBlock::Create(llvm::getGlobalContext(), "start", f, nullptr);
@@ -68,9 +72,9 @@ Builder::ICContext::ICContext(std::string name, JITModule* m,
     auto caller = argI++;
     caller->setName("caller");
     args_.push_back(caller);
-    auto stackmapId = argI++;
-    stackmapId->setName("stackmapId");
-    args_.push_back(stackmapId);
+    auto icSlot = argI++;
+    icSlot->setName("icSlot");
+    args_.push_back(icSlot);
 }
 
 llvm::BasicBlock* Builder::createBasicBlock() {
@@ -134,16 +138,14 @@ SEXP Builder::closeFunction() {
     assert(c_->cp[2] == R_NilValue);
     assert(c_->cp[3] == R_NilValue);
 
-    SEXP typeFeedback = allocVector(INTSXP, c_->instrumentationIndex.size());
-    SEXP typeFeedbackName =
-        allocVector(VECSXP, c_->instrumentationIndex.size());
+    size_t slots = c_->instrumentationKeys.size();
+    SEXP typeFeedback = FeedbackSlot::allocate(slots);
+    SEXP typeFeedbackName = allocVector(VECSXP, slots);
     Protect p;
     p(typeFeedback);
     p(typeFeedbackName);
-    for (auto e : c_->instrumentationIndex) {
-        INTEGER(typeFeedback)[e.second] = static_cast<int>(TypeInfo());
-        SET_VECTOR_ELT(typeFeedbackName, e.second, e.first);
-    }
+    for (size_t i = 0; i < slots; ++i)
+        SET_VECTOR_ELT(typeFeedbackName, i, c_->instrumentationKeys[i]);
     c_->cp[1] = typeFeedback;
     c_->cp[2] = typeFeedbackName;
     SEXP invocationCount = allocVector(INTSXP, 1);
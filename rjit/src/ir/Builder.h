@@ -145,7 +145,7 @@ class Builder {
         // next current one
         x->b = c_->b;
         x->cp = std::move(c_->cp);
-        x->instrumentationIndex = std::move(c_->instrumentationIndex);
+        x->instrumentationKeys = std::move(c_->instrumentationKeys);
         delete c_;
         c_ = x;
     }
@@ -259,8 +259,11 @@ class Builder {
         return c_->addConstantPoolObject(object);
     }
 
-    int getInstrumentationIndex(SEXP sym) {
-        return c_->getInstrumentationIndex(sym);
+    /** Returns a new type feedback slot for a read site of key (the symbol
+      read, or the call).
+     */
+    int addInstrumentationSlot(SEXP key) {
+        return c_->addInstrumentationSlot(key);
     }
 
     /** Returns the index-th object in the constant pool.
@@ -295,13 +298,12 @@ class Builder {
             return cp.size() - 1;
         }
 
-        std::unordered_map<SEXP, int> instrumentationIndex;
-        int getInstrumentationIndex(SEXP sym) {
-            if (instrumentationIndex.count(sym))
-                return instrumentationIndex.at(sym);
-            int next = instrumentationIndex.size();
-            instrumentationIndex[sym] = next;
-            return next;
+        /** Keys of the type feedback slots, one slot per read site.
+         */
+        std::vector<SEXP> instrumentationKeys;
+        int addInstrumentationSlot(SEXP key) {
+            instrumentationKeys.push_back(key);
+            return instrumentationKeys.size() - 1;
         }
 
         bool isReturnJumpNeeded = false;
@@ -344,7 +346,7 @@ class Builder {
         std::vector<llvm::Value*> args_;
 
         Context(Context* from)
-            : instrumentationIndex(std::move(from->instrumentationIndex)),
+            : instrumentationKeys(std::move(from->instrumentationKeys)),
               isReturnJumpNeeded(from->isReturnJumpNeeded),
               isResultVisible(from->isResultVisible),
               assignmentLHS(from->assignmentLHS), f(from->f), b(from->b),
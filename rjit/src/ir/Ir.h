@@ -1041,6 +1041,17 @@ class Switch : public Pattern {
         ins<llvm::SwitchInst>()->addCase(Builder::integer(i), target);
     }
 
+    /** Adds a case matching the address of given SEXP.
+
+      Only valid if the switch condition is a SexpAddress.
+     */
+    void addCase(SEXP value, llvm::BasicBlock* target) {
+        ins<llvm::SwitchInst>()->addCase(
+            llvm::ConstantInt::get(llvm::getGlobalContext(),
+                                   llvm::APInt(64, (std::uint64_t)value)),
+            target);
+    }
+
     // TODO add meaningful accessors
 
     static Switch* create(Builder& b, ir::Value cond,
@@ -1073,6 +1084,36 @@ class Switch : public Pattern {
     }
 };
 
+/** Address of a SEXP as a 64bit integer.
+
+  Allows switching over SEXPs by their identity, such as the CHARSXPs from the
+  global string cache.
+ */
+class SexpAddress : public Pattern {
+  public:
+    llvm::Value* sexp() { return ins_->getOperand(0); }
+
+    static SexpAddress* create(Builder& b, ir::Value sexp) {
+        Sentinel s(b);
+        return insertBefore(s, sexp);
+    }
+
+    static SexpAddress* insertBefore(llvm::Instruction* ins, ir::Value sexp) {
+        return new SexpAddress(new llvm::PtrToIntInst(sexp, t::t_i64, "", ins));
+    }
+
+    static SexpAddress* insertBefore(Pattern* p, ir::Value sexp) {
+        return insertBefore(p->first(), sexp);
+    }
+
+    static bool classof(Pattern const* s) {
+        return s->getKind() == Kind::SexpAddress;
+    }
+
+  protected:
+    SexpAddress(llvm::Instruction* ins) : Pattern(ins, Kind::SexpAddress) {}
+};
+
 /** Anonymous native call.
 
  */
@@ -1120,6 +1161,16 @@ class PrimitiveCall : public Pattern {
      */
     llvm::CallInst* ins() { return Pattern::ins<llvm::CallInst>(); }
 
+    /** Allocation effect of the primitive.
+
+      Primitives which neither allocate nor run any R code (warnings,
+      condition handlers) cannot trigger a gc. Calls to them are emitted as
+      plain calls without a statepoint, so that the live SEXPs need not be
+      spilled around them. Such primitives hide this with a version returning
+      false.
+     */
+    static bool allocates() { return true; }
+
   protected:
     PrimitiveCall(llvm::Instruction* ins, Kind kind) : Pattern(ins, kind) {
         assert(llvm::isa<llvm::CallInst>(ins) and
@@ -1143,6 +1194,14 @@ class PrimitiveCall : public Pattern {
         return result;
     }
 
+    /** Marks the call as a safepoint, unless INTRINSIC does not allocate.
+     */
+    template <typename INTRINSIC>
+    static void markSafepoint(llvm::CallInst* i) {
+        if (INTRINSIC::allocates())
+            Builder::markSafepoint(i);
+    }
+
     llvm::Value* getValue(unsigned argIndex) {
         return ins()->getArgOperand(argIndex);
     }
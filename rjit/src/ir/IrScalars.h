@@ -28,7 +28,7 @@ class AllocVector : public ir::PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<AllocVector>(ins->getModule()),
             {Builder::integer(type), size}, "", ins);
-        Builder::markSafepoint(i);
+        markSafepoint<AllocVector>(i);
         return new AllocVector(i);
     }
 
@@ -378,6 +378,8 @@ class Div : public ir::NativeBinaryOperator {
  */
 class FIsNA : public ir::PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     llvm::Value* value() { return getValue(0); }
 
     static FIsNA* create(ir::Builder& b, ir::Value value) {
@@ -388,7 +390,7 @@ class FIsNA : public ir::PrimitiveCall {
     static FIsNA* insertBefore(llvm::Instruction* ins, ir::Value value) {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<FIsNA>(ins->getModule()), {value}, "", ins);
-        Builder::markSafepoint(i);
+        markSafepoint<FIsNA>(i);
         return new FIsNA(i);
     }
 
@@ -38,6 +38,9 @@ class BoxingRemovalPass : public ir::Pass, public ir::Optimization {
 
 class BoxingRemoval : public ir::OptimizationDriver<BoxingRemovalPass,
                                                     analysis::ScalarsTracking> {
+  public:
+    const char* getPassName() const override { return "BoxingRemoval"; }
+
   protected:
     void setFunction(llvm::Function* f) override {
         ir::OptimizationDriver<BoxingRemovalPass,
@@ -38,7 +38,10 @@ class ConstantLoadPass : public Pass, public Optimization {
     bool dispatch(llvm::BasicBlock::iterator& i) override;
 };
 
-class ConstantLoadOptimization : public LinearDriver<ConstantLoadPass> {};
+class ConstantLoadOptimization : public LinearDriver<ConstantLoadPass> {
+  public:
+    const char* getPassName() const override { return "ConstantLoad"; }
+};
 }
 }
 
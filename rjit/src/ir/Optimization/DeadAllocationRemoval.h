@@ -29,6 +29,9 @@ class DeadAllocationRemovalPass : public ir::Pass, public ir::Optimization {
 class DeadAllocationRemoval
     : public ir::LinearDriver<DeadAllocationRemovalPass> {
   public:
+    const char* getPassName() const override {
+        return "DeadAllocationRemoval";
+    }
 };
 
 } // namespace optimization
@@ -41,8 +41,11 @@ class ScalarsPass : public ir::Pass, public ir::Optimization {
         Value l = tsa()[lhs];
         llvm::Value* rhs = p->rhs();
         Value r = tsa()[rhs];
+        // the scalar result drops any attributes of the operands
         if (l.size() == Value::Size::Scalar and
-            r.size() == Value::Size::Scalar) {
+            r.size() == Value::Size::Scalar and
+            l.shape() == Value::Shape::None and
+            r.shape() == Value::Shape::None) {
             if (l.hasOnlyType(Value::Type::Float) and
                 r.hasOnlyType(Value::Type::Float)) {
                 replaceWithScalar<typename T::ScalarDouble>(p, lhs, rhs,
@@ -75,6 +78,9 @@ class ScalarsPass : public ir::Pass, public ir::Optimization {
 
 class Scalars
     : public ir::OptimizationDriver<ScalarsPass, analysis::TypeAndShape> {
+  public:
+    const char* getPassName() const override { return "Scalars"; }
+
   protected:
     void setFunction(llvm::Function* f) override {
         ir::OptimizationDriver<ScalarsPass,
@@ -7,6 +7,7 @@
 #include "ir/Pass.h"
 #include "llvm.h"
 #include "ir/State.h"
+#include "Profiler.h"
 
 namespace rjit {
 namespace ir {
@@ -45,6 +46,7 @@ class LinearDriver : public PassDriver<Pass> {
         if (f.isDeclaration() || f.empty())
             return false;
 
+        Profiler::Timer timer(&f, this->getPassName());
         pass.setFunction(&f);
         return runOnFunction_(f);
     }
@@ -76,6 +78,7 @@ class ForwardDriver : public PassDriver<PASS> {
     bool runOnFunction(llvm::Function& f) override {
         if (f.isDeclaration() or f.empty())
             return false;
+        Profiler::Timer timer(&f, this->getPassName());
         pass_.setFunction(&f);
         q_.push_back(QueueItem(f.begin(), pass_.initialState(&f)));
         while (not q_.empty()) {
@@ -146,6 +149,7 @@ class OptimizationDriver : public ir::PassDriver<PASS> {
     virtual bool runOnFunction(llvm::Function& f) override {
         if (f.isDeclaration() || f.empty())
             return false;
+        Profiler::Timer timer(&f, this->getPassName());
         return optimize(&f);
     }
 
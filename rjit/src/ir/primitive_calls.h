@@ -31,7 +31,7 @@ class EndClosureContext : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<EndClosureContext>(ins->getModule()),
             arguments(cntxt, result), "", ins);
-        Builder::markSafepoint(i);
+        markSafepoint<EndClosureContext>(i);
         return new EndClosureContext(i);
     }
 
@@ -85,7 +85,7 @@ class ClosureQuickArgumentAdaptor : public PrimitiveCall {
             primitiveFunction<ClosureQuickArgumentAdaptor>(ins->getModule()),
             args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<ClosureQuickArgumentAdaptor>(i);
         ClosureQuickArgumentAdaptor* result =
             new ClosureQuickArgumentAdaptor(i);
         return result;
@@ -126,7 +126,7 @@ class CallNative : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CallNative>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CallNative>(i);
         CallNative* result = new CallNative(i);
         return result;
     }
@@ -228,7 +228,7 @@ class ConvertToLogicalNoNA : public PrimitiveCall {
             primitiveFunction<ConvertToLogicalNoNA>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<ConvertToLogicalNoNA>(i);
         return new ConvertToLogicalNoNA(i);
     }
 
@@ -269,7 +269,7 @@ class PrintValue : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<PrintValue>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<PrintValue>(i);
         return new PrintValue(i);
     }
 
@@ -313,7 +313,7 @@ class StartFor : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<StartFor>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<StartFor>(i);
         return new StartFor(i);
     }
 
@@ -370,7 +370,7 @@ class LoopSequenceLength : public PrimitiveCall {
             primitiveFunction<LoopSequenceLength>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<LoopSequenceLength>(i);
         return new LoopSequenceLength(i);
     }
 
@@ -421,7 +421,7 @@ class GetForLoopValue : public PrimitiveCall {
             primitiveFunction<GetForLoopValue>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetForLoopValue>(i);
         return new GetForLoopValue(i);
     }
 
@@ -484,7 +484,7 @@ class GetDispatchValue : public PrimitiveCall {
             primitiveFunction<GetDispatchValue>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetDispatchValue>(i);
         return new GetDispatchValue(i);
     }
 
@@ -550,7 +550,7 @@ class GetMatrixValue : public PrimitiveCall {
             primitiveFunction<GetMatrixValue>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetMatrixValue>(i);
         return new GetMatrixValue(i);
     }
 
@@ -618,7 +618,7 @@ class GetDispatchValue2 : public PrimitiveCall {
             primitiveFunction<GetDispatchValue2>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetDispatchValue2>(i);
         return new GetDispatchValue2(i);
     }
 
@@ -684,7 +684,7 @@ class GetMatrixValue2 : public PrimitiveCall {
             primitiveFunction<GetMatrixValue2>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetMatrixValue2>(i);
         return new GetMatrixValue2(i);
     }
 
@@ -761,7 +761,7 @@ class AssignDispatchValue : public PrimitiveCall {
             primitiveFunction<AssignDispatchValue>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AssignDispatchValue>(i);
         return new AssignDispatchValue(i);
     }
 
@@ -838,7 +838,7 @@ class AssignMatrixValue : public PrimitiveCall {
             primitiveFunction<AssignMatrixValue>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AssignMatrixValue>(i);
         return new AssignMatrixValue(i);
     }
 
@@ -918,7 +918,7 @@ class AssignDispatchValue2 : public PrimitiveCall {
             primitiveFunction<AssignDispatchValue2>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AssignDispatchValue2>(i);
         return new AssignDispatchValue2(i);
     }
 
@@ -992,7 +992,7 @@ class AssignMatrixValue2 : public PrimitiveCall {
             primitiveFunction<AssignMatrixValue2>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AssignMatrixValue2>(i);
         return new AssignMatrixValue2(i);
     }
 
@@ -1068,7 +1068,7 @@ class SuperAssignDispatch : public PrimitiveCall {
             primitiveFunction<SuperAssignDispatch>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SuperAssignDispatch>(i);
         return new SuperAssignDispatch(i);
     }
 
@@ -1142,7 +1142,7 @@ class SuperAssignMatrix : public PrimitiveCall {
             primitiveFunction<SuperAssignMatrix>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SuperAssignMatrix>(i);
         return new SuperAssignMatrix(i);
     }
 
@@ -1218,7 +1218,7 @@ class SuperAssignDispatch2 : public PrimitiveCall {
             primitiveFunction<SuperAssignDispatch2>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SuperAssignDispatch2>(i);
         return new SuperAssignDispatch2(i);
     }
 
@@ -1292,7 +1292,7 @@ class SuperAssignMatrix2 : public PrimitiveCall {
             primitiveFunction<SuperAssignMatrix2>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SuperAssignMatrix2>(i);
         return new SuperAssignMatrix2(i);
     }
 
@@ -1322,6 +1322,8 @@ class SuperAssignMatrix2 : public PrimitiveCall {
 
 class MarkVisible : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     MarkVisible(llvm::Instruction* ins)
         : PrimitiveCall(ins, Kind::MarkVisible) {}
 
@@ -1337,7 +1339,7 @@ class MarkVisible : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<MarkVisible>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<MarkVisible>(i);
         return new MarkVisible(i);
     }
 
@@ -1360,6 +1362,8 @@ class MarkVisible : public PrimitiveCall {
 
 class MarkInvisible : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     MarkInvisible(llvm::Instruction* ins)
         : PrimitiveCall(ins, Kind::MarkInvisible) {}
 
@@ -1375,7 +1379,7 @@ class MarkInvisible : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<MarkInvisible>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<MarkInvisible>(i);
         return new MarkInvisible(i);
     }
 
@@ -1401,6 +1405,8 @@ class MarkInvisible : public PrimitiveCall {
 // the value from the constant pool and marking it as not mutable.
 class UserLiteral : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     llvm::Value* constantPool() { return getValue(0); }
 
     int index() { return getValueInt(1); }
@@ -1432,7 +1438,7 @@ class UserLiteral : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<UserLiteral>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<UserLiteral>(i);
         return new UserLiteral(i);
     }
 
@@ -1456,24 +1462,24 @@ class PatchIC : public PrimitiveCall {
   public:
     PatchIC(llvm::Instruction* ins) : PrimitiveCall(ins, Kind::PatchIC) {}
 
-    static PatchIC* create(Builder& b, ir::Value addr, ir::Value stackmapId,
+    static PatchIC* create(Builder& b, ir::Value addr, ir::Value icSlot,
                            ir::Value caller) {
         Sentinel s(b);
-        return insertBefore(s, addr, stackmapId, caller);
+        return insertBefore(s, addr, icSlot, caller);
     }
 
     static PatchIC* insertBefore(llvm::Instruction* ins, ir::Value addr,
-                                 ir::Value stackmapId, ir::Value caller) {
+                                 ir::Value icSlot, ir::Value caller) {
 
         std::vector<llvm::Value*> args_;
         args_.push_back(addr);
-        args_.push_back(stackmapId);
+        args_.push_back(icSlot);
         args_.push_back(caller);
 
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<PatchIC>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<PatchIC>(i);
         return new PatchIC(i);
     }
 
@@ -1495,25 +1501,25 @@ class CompileIC : public PrimitiveCall {
 
     static CompileIC* create(Builder& b, ir::Value size, ir::Value call,
                              ir::Value fun, ir::Value rho,
-                             ir::Value stackmapId) {
+                             ir::Value icSlot) {
         Sentinel s(b);
-        return insertBefore(s, size, call, fun, rho, stackmapId);
+        return insertBefore(s, size, call, fun, rho, icSlot);
     }
 
     static CompileIC* insertBefore(llvm::Instruction* ins, ir::Value size,
                                    ir::Value call, ir::Value fun, ir::Value rho,
-                                   ir::Value stackmapId) {
+                                   ir::Value icSlot) {
         std::vector<llvm::Value*> args_;
         args_.push_back(size);
         args_.push_back(call);
         args_.push_back(fun);
         args_.push_back(rho);
-        args_.push_back(stackmapId);
+        args_.push_back(icSlot);
 
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CompileIC>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CompileIC>(i);
         return new CompileIC(i);
     }
 
@@ -1559,7 +1565,7 @@ class InitClosureContext : public PrimitiveCall {
             primitiveFunction<InitClosureContext>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<InitClosureContext>(i);
         return new InitClosureContext(i);
     }
 
@@ -1598,7 +1604,7 @@ class NewEnv : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<NewEnv>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<NewEnv>(i);
         return new NewEnv(i);
     }
 
@@ -1632,7 +1638,7 @@ class ConsNr : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<ConsNr>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<ConsNr>(i);
         return new ConsNr(i);
     }
 
@@ -1650,6 +1656,8 @@ class ConsNr : public PrimitiveCall {
 // Just returns the index-th constant from the constant pool.
 class Constant : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     llvm::Value* constantPool() { return getValue(0); }
 
     int index() { return getValueInt(1); }
@@ -1678,7 +1686,7 @@ class Constant : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<Constant>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<Constant>(i);
         return new Constant(i);
     }
 
@@ -1735,7 +1743,7 @@ class GenericGetVar : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericGetVar>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGetVar>(i);
         return new GenericGetVar(i);
     }
 
@@ -1794,7 +1802,7 @@ class GenericGetEllipsisArg : public PrimitiveCall {
             primitiveFunction<GenericGetEllipsisArg>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGetEllipsisArg>(i);
         return new GenericGetEllipsisArg(i);
     }
 
@@ -1853,7 +1861,7 @@ class GenericSetVar : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericSetVar>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericSetVar>(i);
         return new GenericSetVar(i);
     }
 
@@ -1914,7 +1922,7 @@ class GenericSetVarParent : public PrimitiveCall {
             primitiveFunction<GenericSetVarParent>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericSetVarParent>(i);
         return new GenericSetVarParent(i);
     }
 
@@ -1970,7 +1978,7 @@ class GetFunction : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GetFunction>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetFunction>(i);
         return new GetFunction(i);
     }
 
@@ -2024,7 +2032,7 @@ class GetGlobalFunction : public PrimitiveCall {
             primitiveFunction<GetGlobalFunction>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetGlobalFunction>(i);
         return new GetGlobalFunction(i);
     }
 
@@ -2077,7 +2085,7 @@ class GetSymFunction : public PrimitiveCall {
             primitiveFunction<GetSymFunction>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetSymFunction>(i);
         return new GetSymFunction(i);
     }
 
@@ -2130,7 +2138,7 @@ class GetBuiltinFunction : public PrimitiveCall {
             primitiveFunction<GetBuiltinFunction>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetBuiltinFunction>(i);
         return new GetBuiltinFunction(i);
     }
 
@@ -2183,7 +2191,7 @@ class GetInternalBuiltinFunction : public PrimitiveCall {
             primitiveFunction<GetInternalBuiltinFunction>(ins->getModule()),
             args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GetInternalBuiltinFunction>(i);
         return new GetInternalBuiltinFunction(i);
     }
 
@@ -2223,7 +2231,7 @@ class CheckFunction : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CheckFunction>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CheckFunction>(i);
         return new CheckFunction(i);
     }
 
@@ -2267,7 +2275,7 @@ class CreatePromise : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CreatePromise>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CreatePromise>(i);
         return new CreatePromise(i);
     }
 
@@ -2291,6 +2299,8 @@ class CreatePromise : public PrimitiveCall {
 // having an function for it simplifies the analysis on our end.
 class SexpType : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     llvm::Value* value() { return getValue(0); }
 
     SexpType(llvm::Instruction* ins) : PrimitiveCall(ins, Kind::SexpType) {}
@@ -2308,7 +2318,7 @@ class SexpType : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<SexpType>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SexpType>(i);
         return new SexpType(i);
     }
 
@@ -2349,7 +2359,7 @@ class AddArgument : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<AddArgument>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AddArgument>(i);
         return new AddArgument(i);
     }
 
@@ -2397,7 +2407,7 @@ class AddKeywordArgument : public PrimitiveCall {
             primitiveFunction<AddKeywordArgument>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AddKeywordArgument>(i);
         return new AddKeywordArgument(i);
     }
 
@@ -2446,7 +2456,7 @@ class AddEllipsisArgumentHead : public PrimitiveCall {
             primitiveFunction<AddEllipsisArgumentHead>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AddEllipsisArgumentHead>(i);
         return new AddEllipsisArgumentHead(i);
     }
 
@@ -2495,7 +2505,7 @@ class AddEllipsisArgumentTail : public PrimitiveCall {
             primitiveFunction<AddEllipsisArgumentTail>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<AddEllipsisArgumentTail>(i);
         return new AddEllipsisArgumentTail(i);
     }
 
@@ -2545,7 +2555,7 @@ class CallBuiltin : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CallBuiltin>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CallBuiltin>(i);
         return new CallBuiltin(i);
     }
 
@@ -2596,7 +2606,7 @@ class CallSpecial : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CallSpecial>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CallSpecial>(i);
         return new CallSpecial(i);
     }
 
@@ -2647,7 +2657,7 @@ class CallClosure : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CallClosure>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CallClosure>(i);
         return new CallClosure(i);
     }
 
@@ -2714,7 +2724,7 @@ class CreateClosure : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CreateClosure>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CreateClosure>(i);
         return new CreateClosure(i);
     }
 
@@ -2775,7 +2785,7 @@ class GenericUnaryMinus : public PrimitiveCall {
             primitiveFunction<GenericUnaryMinus>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericUnaryMinus>(i);
         return new GenericUnaryMinus(i);
     }
 
@@ -2836,7 +2846,7 @@ class GenericUnaryPlus : public PrimitiveCall {
             primitiveFunction<GenericUnaryPlus>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericUnaryPlus>(i);
         return new GenericUnaryPlus(i);
     }
 
@@ -2913,7 +2923,7 @@ class GenericAdd : public ir::PrimitiveBinaryOperator {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericAdd>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericAdd>(i);
         return new GenericAdd(i);
     }
 
@@ -2965,7 +2975,7 @@ class GenericSub : public ir::PrimitiveBinaryOperator {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericSub>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericSub>(i);
         return new GenericSub(i);
     }
 
@@ -3017,7 +3027,7 @@ class GenericMul : public ir::PrimitiveBinaryOperator {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericMul>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericMul>(i);
         return new GenericMul(i);
     }
 
@@ -3069,7 +3079,7 @@ class GenericDiv : public ir::PrimitiveBinaryOperator {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericDiv>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericDiv>(i);
         return new GenericDiv(i);
     }
 
@@ -3133,7 +3143,7 @@ class GenericPow : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericPow>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericPow>(i);
         return new GenericPow(i);
     }
 
@@ -3192,7 +3202,7 @@ class GenericSqrt : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericSqrt>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericSqrt>(i);
         return new GenericSqrt(i);
     }
 
@@ -3249,7 +3259,7 @@ class GenericExp : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericExp>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericExp>(i);
         return new GenericExp(i);
     }
 
@@ -3315,7 +3325,7 @@ class GenericEq : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericEq>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericEq>(i);
         return new GenericEq(i);
     }
 
@@ -3368,7 +3378,7 @@ class GenericNe : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericNe>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericNe>(i);
         return new GenericNe(i);
     }
 
@@ -3428,7 +3438,7 @@ class GenericLt : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericLt>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericLt>(i);
         return new GenericLt(i);
     }
 
@@ -3488,7 +3498,7 @@ class GenericLe : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericLe>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericLe>(i);
         return new GenericLe(i);
     }
 
@@ -3548,7 +3558,7 @@ class GenericGe : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericGe>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGe>(i);
         return new GenericGe(i);
     }
 
@@ -3608,7 +3618,7 @@ class GenericGt : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericGt>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGt>(i);
         return new GenericGt(i);
     }
 
@@ -3669,7 +3679,7 @@ class GenericBitAnd : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericBitAnd>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericBitAnd>(i);
         return new GenericBitAnd(i);
     }
 
@@ -3730,7 +3740,7 @@ class GenericBitOr : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericBitOr>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericBitOr>(i);
         return new GenericBitOr(i);
     }
 
@@ -3788,7 +3798,7 @@ class GenericNot : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<GenericNot>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericNot>(i);
         return new GenericNot(i);
     }
 
@@ -3834,7 +3844,7 @@ class GenericGetVarMissOK : public PrimitiveCall {
             primitiveFunction<GenericGetVarMissOK>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGetVarMissOK>(i);
         return new GenericGetVarMissOK(i);
     }
 
@@ -3879,7 +3889,7 @@ class GenericGetEllipsisValueMissOK : public PrimitiveCall {
             primitiveFunction<GenericGetEllipsisValueMissOK>(ins->getModule()),
             args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<GenericGetEllipsisValueMissOK>(i);
         return new GenericGetEllipsisValueMissOK(i);
     }
 
@@ -3937,7 +3947,7 @@ class CheckSwitchControl : public PrimitiveCall {
             primitiveFunction<CheckSwitchControl>(ins->getModule()), args_, "",
             ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CheckSwitchControl>(i);
         return new CheckSwitchControl(i);
     }
 
@@ -4005,7 +4015,7 @@ class SwitchControlCharacter : public PrimitiveCall {
             primitiveFunction<SwitchControlCharacter>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SwitchControlCharacter>(i);
         return new SwitchControlCharacter(i);
     }
 
@@ -4053,7 +4063,7 @@ class SwitchControlInteger : public PrimitiveCall {
             primitiveFunction<SwitchControlInteger>(ins->getModule()), args_,
             "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<SwitchControlInteger>(i);
         return new SwitchControlInteger(i);
     }
 
@@ -4095,7 +4105,7 @@ class ReturnJump : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<ReturnJump>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<ReturnJump>(i);
         return new ReturnJump(i);
     }
 
@@ -4137,7 +4147,7 @@ class Recompile : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<Recompile>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<Recompile>(i);
         return new Recompile(i);
     }
 
@@ -4156,6 +4166,8 @@ class Recompile : public PrimitiveCall {
 
 class CheckType : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     CheckType(llvm::Instruction* ins) : PrimitiveCall(ins, Kind::CheckType) {}
 
     static CheckType* create(Builder& b, ir::Value value, TypeInfo expected) {
@@ -4173,7 +4185,7 @@ class CheckType : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<CheckType>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<CheckType>(i);
         return new CheckType(i);
     }
 
@@ -4190,13 +4202,15 @@ class CheckType : public PrimitiveCall {
 
 class RecordType : public PrimitiveCall {
   public:
+    static bool allocates() { return false; }
+
     RecordType(llvm::Instruction* ins) : PrimitiveCall(ins, Kind::RecordType) {}
 
     static RecordType* create(Builder& b, SEXP sym, ir::Value value) {
         Sentinel s(b);
         ir::Value store =
             UserLiteral::insertBefore(s, b.consts(), Builder::integer(1));
-        int idx = b.getInstrumentationIndex(sym);
+        int idx = b.addInstrumentationSlot(sym);
         return insertBefore(s, value, store, idx);
     }
 
@@ -4211,7 +4225,7 @@ class RecordType : public PrimitiveCall {
         llvm::CallInst* i = llvm::CallInst::Create(
             primitiveFunction<RecordType>(ins->getModule()), args_, "", ins);
 
-        Builder::markSafepoint(i);
+        markSafepoint<RecordType>(i);
         return new RecordType(i);
     }
 
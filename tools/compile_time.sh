@@ -60,12 +60,7 @@ COMPILE_TIME_PACKAGE="
 timestamp <- Sys.time();
 benv <- getNamespace('$PACKAGE');
 start <- Sys.time();
-for (name in names(benv)) {
-  x <- benv[[name]];
-  if (typeof(x) == 'closure') {
-    res <- jit.compile(x);
-  }
-};
+jit.compileEnvironment(benv, '$PACKAGE');
 compile_time <- list('$COMMIT_ID'=list(timestamp, Sys.time() - start));
 filename <- paste('$PACKAGE', '_package_', '$COMMIT_ID', '.Rds', sep = '');
 saveRDS(compile_time, filename);